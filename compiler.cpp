@@ -1,30 +1,31 @@
 #define NDEBUG
 
 #include <cstdio>
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
+#include <climits>
 #include <cassert>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <algorithm>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <set>
+#include <thread>
+#include <atomic>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(NO_SIMD)
+#include <immintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-namespace Reader {
-    std::vector<int> numbers;
-    int pos;
-    inline int read() {
-        return numbers[pos++];
-    }
-}
-enum char_type { 
-    EMPTY,
-    ALPHA,
-    DIGIT,
-    OTHER
-};
-enum stmt_type {
+enum stmt_type : uint8_t {
     PROGRAM,
     FUNCDEF,
     VARDEF,
@@ -36,6 +37,7 @@ enum stmt_type {
     FOR,
     WHILE,
     RETURN,
+    TAILCALL,
     UNIT0,
     UNIT1,
     UNIT2,
@@ -46,6 +48,7 @@ enum stmt_type {
     UNIT7,
     UNIT8,
     UNIT9,
+    INLINE,
     NOSTMT
 };
 enum obj_type {
@@ -57,612 +60,2875 @@ enum obj_type {
     VALUE,
     FUNCTION
 };
+// operators run in the order of op_type, so that T_PLUS + op is the token
+// of op
+enum token_type : uint8_t {
+    T_END,
+    T_NAME,
+    T_NUMBER,
+    T_INT,
+    T_IF,
+    T_ELSE,
+    T_FOR,
+    T_WHILE,
+    T_RETURN,
+    T_CIN,
+    T_COUT,
+    T_ENDL,
+    T_PLUS,
+    T_MINUS,
+    T_TIMES,
+    T_DIVIDE,
+    T_MODULO,
+    T_LESS,
+    T_LESS_EQUAL,
+    T_GREATER,
+    T_GREATER_EQUAL,
+    T_EQUAL,
+    T_NOT_EQUAL,
+    T_XOR,
+    T_AND,
+    T_OR,
+    T_ASSIGN,
+    T_NOT,
+    T_SHIFT_LEFT,
+    T_SHIFT_RIGHT,
+    T_COMMA,
+    T_SEMICOLON,
+    T_LPAREN,
+    T_RPAREN,
+    T_LBRACE,
+    T_RBRACE,
+    T_LBRACKET,
+    T_RBRACKET,
+    T_HASH,
+    T_AMPERSAND,
+    T_BAR
+};
+
+// the whole input, read once. a regular file is mapped as it is, anything
+// else (a pipe, a terminal) is read in large blocks. the lexer then scans
+// [cur, end) directly.
+namespace Stream {
+    const size_t BLOCK = 1 << 16;
+
+    const char* cur;
+    const char* end;
+    std::vector<char> data;
+
+    inline void load() {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = fileno(stdin);
+        struct stat st;
+        off_t at = lseek(fd, 0, SEEK_CUR);
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && at >= 0 && st.st_size > at) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                cur = (const char*)p + at;
+                end = (const char*)p + st.st_size;
+                return;
+            }
+        }
+        for (ssize_t n = 1; n > 0; ) {
+            size_t size = data.size();
+            data.resize(size + BLOCK);
+            n = read(fd, data.data() + size, BLOCK);
+            data.resize(size + std::max<ssize_t>(n, 0));
+        }
+#else
+        for (size_t n = 1; n > 0; ) {
+            size_t size = data.size();
+            data.resize(size + BLOCK);
+            n = fread(data.data() + size, 1, BLOCK, stdin);
+            data.resize(size + n);
+        }
+#endif
+        cur = data.data();
+        end = data.data() + data.size();
+    }
+
+    // the integer at p, after the blanks before it, 0 if there is none
+    inline int number(const char*& p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+        bool neg = p < end && *p == '-';
+        p += neg;
+        uint32_t ret = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(NO_SIMD)
+        // up to eight digits at once, without a branch per digit: a byte
+        // is no digit if it is below '0' or 0x76 more than it overflows. the
+        // digits are moved to the top and summed in pairs, fours and eights
+        if (end - p >= 8) {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            v -= 0x3030303030303030ull;
+            uint64_t miss = (v | (v + 0x7676767676767676ull)) & 0x8080808080808080ull;
+            int n = miss ? __builtin_ctzll(miss) >> 3 : 8;
+            if (n > 0) {
+                v <<= 64 - 8 * n;
+                v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFull;
+                v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFull;
+                ret = uint32_t(v * 10000 + (v >> 32));
+                p += n;
+                if (n < 8) return neg ? -ret : ret;
+            }
+        }
+#endif
+        while (p < end && '0' <= *p && *p <= '9') ret = ret * 10 + (*p++ - '0');
+        return neg ? -ret : ret;
+    }
+}
+
+// cout, endl and putchar all write to one buffer, which goes out when it is
+// full, when the program is done, and with --interactive at every newline
+namespace Output {
+    const size_t SIZE = 1 << 16;
+
+    char buffer[SIZE];
+    size_t used;
+    bool interactive;
+
+    inline void flush() {
+        fwrite(buffer, 1, used, stdout);
+        fflush(stdout);
+        used = 0;
+    }
+
+    inline void put(char ch) {
+        if (used == SIZE) flush();
+        buffer[used++] = ch;
+        if (interactive && ch == '\n') flush();
+    }
+
+    inline void endl() {
+        put('\n');
+    }
+
+    // two digits a step, from the back of a scratch buffer
+    inline void number(int x) {
+        static const char pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        if (SIZE - used < 11) flush();
+        uint32_t u = x < 0 ? 0u - uint32_t(x) : uint32_t(x);
+        char digits[10];
+        char* p = digits + 10;
+        for (; u >= 100; u /= 100) {
+            p -= 2;
+            memcpy(p, pairs + 2 * (u % 100), 2);
+        }
+        if (u >= 10) {
+            p -= 2;
+            memcpy(p, pairs + 2 * u, 2);
+        } else {
+            *--p = char('0' + u);
+        }
+        if (x < 0) buffer[used++] = '-';
+        size_t n = digits + 10 - p;
+        memcpy(buffer + used, p, n);
+        used += n;
+    }
+}
+
+// every distinct identifier gets a dense id the first time the lexer sees
+// it. from then on names are only ever compared, hashed and stored as ids.
+namespace Symbol {
+    std::vector<std::string> names;
+    std::vector<uint32_t> hashes;
+    std::vector<int> table;  // open addressing into names, -1 is empty
+
+    inline uint32_t hash(const char* s, size_t n) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+        return h;
+    }
+
+    inline void grow() {
+        table.assign(std::max<size_t>(64, table.size() * 2), -1);
+        size_t mask = table.size() - 1;
+        for (size_t id = 0; id < names.size(); id++) {
+            size_t i = hashes[id] & mask;
+            while (table[i] != -1) i = (i + 1) & mask;
+            table[i] = id;
+        }
+    }
+
+    inline int intern(const char* s, size_t n) {
+        if (2 * (names.size() + 1) > table.size()) grow();
+        uint32_t h = hash(s, n);
+        size_t mask = table.size() - 1;
+        size_t i = h & mask;
+        for (; table[i] != -1; i = (i + 1) & mask) {
+            const std::string& t = names[table[i]];
+            if (hashes[table[i]] == h && t.size() == n && memcmp(t.data(), s, n) == 0)
+                return table[i];
+        }
+        table[i] = names.size();
+        names.emplace_back(s, n);
+        hashes.push_back(h);
+        return table[i];
+    }
+
+    inline int intern(const char* s) {
+        return intern(s, strlen(s));
+    }
+
+    inline const char* name(int id) {
+        return names[id].c_str();
+    }
+}
+
+// finds the end of a run of whitespace, of name characters or of digits.
+// on x86 the runs are classified 16 (SSE2) or, with --avx2 on a cpu that
+// has it, 32 (AVX2) bytes at a time and the first byte outside the class is found from the
+// bitmask; the tail and every other target go byte by byte.
+namespace Scan {
+    typedef const char* (*scan_fn)(const char*, const char*);
+
+    inline bool isSpace(char ch) { return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t'; }
+    inline bool isDigit(char ch) { return '0' <= ch && ch <= '9'; }
+    inline bool isWord(char ch) {
+        return isDigit(ch) || ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == '_';
+    }
+
+    // skips blanks and n words, runs of anything else, from p on, where blank
+    // is whether the byte before p was one. stops where the next word starts
+    inline const char* skipBytes(const char* p, const char* end, size_t n, bool blank) {
+        for (; p < end; p++) {
+            bool b = isSpace(*p);
+            if (blank && !b && n-- == 0) break;
+            blank = b;
+        }
+        return p;
+    }
+
+    // runs in source text are short, and the 32-byte loads measured slower
+    // than the 16-byte ones; so AVX2 is only used when asked for
+    bool avx2Wanted = false;
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(NO_SIMD)
+    // bytes of x in [lo, lo + n]
+    inline __m128i range(__m128i x, char lo, char n) {
+        __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(n)), d);
+    }
+    inline __m128i space(__m128i x) {
+        return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))),
+                            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))));
+    }
+    inline __m128i word(__m128i x) {
+        __m128i alpha = range(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z' - 'a');
+        return _mm_or_si128(_mm_or_si128(alpha, range(x, '0', 9)), _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+    }
+
+    template <__m128i (*match)(__m128i), bool (*scalar)(char)>
+    const char* sse2(const char* p, const char* end) {
+        for (; p + 16 <= end; p += 16) {
+            unsigned miss = ~_mm_movemask_epi8(match(_mm_loadu_si128((const __m128i*)p))) & 0xffff;
+            if (miss) return p + __builtin_ctz(miss);
+        }
+        while (p < end && scalar(*p)) p++;
+        return p;
+    }
+
+    inline __m128i digits(__m128i x) { return range(x, '0', 9); }
+
+    __attribute__((target("avx2"))) inline __m256i range256(__m256i x, char lo, char n) {
+        __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(n)), d);
+    }
+    __attribute__((target("avx2"))) inline __m256i space256(__m256i x) {
+        return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'))),
+                               _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'))));
+    }
+    __attribute__((target("avx2"))) inline __m256i word256(__m256i x) {
+        __m256i alpha = range256(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a');
+        return _mm256_or_si256(_mm256_or_si256(alpha, range256(x, '0', 9)), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+    }
+    __attribute__((target("avx2"))) inline __m256i digits256(__m256i x) { return range256(x, '0', 9); }
+
+    template <__m256i (*match)(__m256i), bool (*scalar)(char)>
+    __attribute__((target("avx2"))) const char* avx2(const char* p, const char* end) {
+        for (; p + 32 <= end; p += 32) {
+            unsigned miss = ~(unsigned)_mm256_movemask_epi8(match(_mm256_loadu_si256((const __m256i*)p)));
+            if (miss) return p + __builtin_ctz(miss);
+        }
+        while (p < end && scalar(*p)) p++;
+        return p;
+    }
+
+    // skips n words, counting where words start 16 bytes at a time. the
+    // block that holds the end of the last one goes byte by byte
+    inline const char* skip(const char* p, const char* end, size_t n) {
+        bool blank = true;
+        for (; p + 16 <= end; p += 16) {
+            unsigned blanks = _mm_movemask_epi8(space(_mm_loadu_si128((const __m128i*)p)));
+            unsigned starts = ~blanks & (blanks << 1 | blank) & 0xffff;
+            unsigned k = __builtin_popcount(starts);
+            if (k > n) break;
+            n -= k;
+            blank = blanks >> 15;
+        }
+        return skipBytes(p, end, n, blank);
+    }
+
+    scan_fn spaces = sse2<space, isSpace>;
+    scan_fn words = sse2<word, isWord>;
+    scan_fn numbers = sse2<digits, isDigit>;
+
+    inline void init() {
+        if (avx2Wanted && __builtin_cpu_supports("avx2")) {
+            spaces = avx2<space256, isSpace>;
+            words = avx2<word256, isWord>;
+            numbers = avx2<digits256, isDigit>;
+        }
+    }
+#else
+    template <bool (*scalar)(char)>
+    const char* bytes(const char* p, const char* end) {
+        while (p < end && scalar(*p)) p++;
+        return p;
+    }
+
+    scan_fn spaces = bytes<isSpace>;
+    scan_fn words = bytes<isWord>;
+    scan_fn numbers = bytes<isDigit>;
+
+    inline const char* skip(const char* p, const char* end, size_t n) {
+        return skipBytes(p, end, n, true);
+    }
+
+    inline void init() {
+    }
+#endif
+}
+
+// keywords and operators are told apart by switching on keys that are
+// constant expressions. the case labels are computed by the compiler, so a
+// collision between two keywords fails to compile, and a hit costs one
+// compare of at most six bytes against the keyword itself.
+namespace Keyword {
+    // perfect over the nine keywords: the keys of all of them differ
+    constexpr unsigned hash(const char* s, size_t n) {
+        return ((unsigned char)s[0] + 3 * (unsigned char)s[n - 1] + n) & 31;
+    }
+    template <size_t N>
+    constexpr unsigned hash(const char (&s)[N]) {
+        return hash(s, N - 1);
+    }
+
+    template <size_t N>
+    inline token_type is(const char* s, size_t n, const char (&k)[N], token_type kind) {
+        return n == N - 1 && memcmp(s, k, n) == 0 ? kind : T_NAME;
+    }
+
+    // T_NAME unless s[0, n) is a keyword
+    inline token_type word(const char* s, size_t n) {
+        switch (hash(s, n)) {
+            case hash("int"): return is(s, n, "int", T_INT);
+            case hash("if"): return is(s, n, "if", T_IF);
+            case hash("else"): return is(s, n, "else", T_ELSE);
+            case hash("for"): return is(s, n, "for", T_FOR);
+            case hash("while"): return is(s, n, "while", T_WHILE);
+            case hash("return"): return is(s, n, "return", T_RETURN);
+            case hash("cin"): return is(s, n, "cin", T_CIN);
+            case hash("cout"): return is(s, n, "cout", T_COUT);
+            case hash("endl"): return is(s, n, "endl", T_ENDL);
+            default: return T_NAME;
+        }
+    }
+
+    constexpr unsigned pair(char a, char b) {
+        return (unsigned char)a << 8 | (unsigned char)b;
+    }
+
+    // T_END unless a b is a two-char operator
+    inline token_type two(char a, char b) {
+        switch (pair(a, b)) {
+            case pair('<', '='): return T_LESS_EQUAL;
+            case pair('>', '='): return T_GREATER_EQUAL;
+            case pair('=', '='): return T_EQUAL;
+            case pair('!', '='): return T_NOT_EQUAL;
+            case pair('&', '&'): return T_AND;
+            case pair('|', '|'): return T_OR;
+            case pair('<', '<'): return T_SHIFT_LEFT;
+            case pair('>', '>'): return T_SHIFT_RIGHT;
+            default: return T_END;
+        }
+    }
+
+    // T_END unless a is a token by itself
+    inline token_type one(char a) {
+        switch (a) {
+            case '+': return T_PLUS;
+            case '-': return T_MINUS;
+            case '*': return T_TIMES;
+            case '/': return T_DIVIDE;
+            case '%': return T_MODULO;
+            case '^': return T_XOR;
+            case '<': return T_LESS;
+            case '>': return T_GREATER;
+            case '=': return T_ASSIGN;
+            case '!': return T_NOT;
+            case '&': return T_AMPERSAND;
+            case '|': return T_BAR;
+            case ',': return T_COMMA;
+            case ';': return T_SEMICOLON;
+            case '(': return T_LPAREN;
+            case ')': return T_RPAREN;
+            case '{': return T_LBRACE;
+            case '}': return T_RBRACE;
+            case '[': return T_LBRACKET;
+            case ']': return T_RBRACKET;
+            case '#': return T_HASH;
+            default: return T_END;
+        }
+    }
+}
+
+// the numbers the program reads with cin, which come first in the input
+// after a count of them. by default they are all converted up front; with
+// --input=lazy they are only skipped over, and each one is converted when
+// the program reads it; with --input=pipe another thread converts them
+// while the program is parsed and run
+namespace Reader {
+    enum Mode : uint8_t { EAGER, LAZY, PIPE };
+
+    Mode mode;
+    std::vector<int> numbers;
+    size_t pos;
+    const char* cur;  // lazy: the first number not read yet
+    const char* end;  // lazy: the end of the numbers
+
+    // --input=pipe: a producer thread converts the numbers into a ring,
+    // which read() takes them from, waiting only if it gets ahead
+    const size_t RING = 1 << 16;
+    int ring[RING];
+    std::atomic<size_t> head;  // numbers put in the ring, by the producer
+    std::atomic<size_t> tail;  // numbers taken out, by read()
+    std::atomic<bool> stop;
+    size_t count;
+    std::thread producer;
+
+    inline void produce(const char* p, const char* e) {
+        for (size_t i = 0; i < count; i++) {
+            int x = Stream::number(p, e);
+            while (i - tail.load(std::memory_order_acquire) == RING) {
+                if (stop.load(std::memory_order_relaxed)) return;
+                std::this_thread::yield();
+            }
+            ring[i & (RING - 1)] = x;
+            head.store(i + 1, std::memory_order_release);
+        }
+    }
+
+    inline int take() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == count) return 0;
+        while (head.load(std::memory_order_acquire) == t) std::this_thread::yield();
+        int x = ring[t & (RING - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return x;
+    }
+
+    // reads the numbers, leaving Stream at the program
+    inline void load() {
+        int n = Stream::number(Stream::cur, Stream::end);
+        if (mode == EAGER) {
+            numbers.resize(std::max(n, 0));
+            for (auto& x : numbers) x = Stream::number(Stream::cur, Stream::end);
+            return;
+        }
+        cur = Stream::cur;
+        Stream::cur = end = Scan::skip(Stream::cur, Stream::end, std::max(n, 0));
+        if (mode == PIPE) {
+            count = std::max(n, 0);
+            producer = std::thread(produce, cur, end);
+        }
+    }
+
+    // stops the producer, which may wait on numbers nobody reads
+    inline void finish() {
+        if (!producer.joinable()) return;
+        stop.store(true);
+        producer.join();
+    }
+
+    // past the last number every mode reads 0
+    inline int read() {
+        if (mode == EAGER) return pos < numbers.size() ? numbers[pos++] : 0;
+        if (mode == LAZY) return Stream::number(cur, end);
+        return take();
+    }
+}
+
+// turns the whole source into a vector of Tokens in one pass. names are
+// interned as they are met, numbers are converted, so the parser only ever
+// compares kinds and symbol ids.
+namespace Lexer {
+    struct Token {
+        token_type kind;
+        uint32_t at;  // offset in the source
+        int value;    // T_NAME: symbol id, T_NUMBER: the number
+    };
+
+    const char* spelling[] = {
+        "", "name", "number", "int", "if", "else", "for", "while", "return",
+        "cin", "cout", "endl",
+        "+", "-", "*", "/", "%", "<", "<=", ">", ">=", "==", "!=", "^", "&&", "||",
+        "=", "!", "<<", ">>",
+        ",", ";", "(", ")", "{", "}", "[", "]", "#", "&", "|"
+    };
+
+    std::vector<Token> tokens;
+    thread_local size_t pos;
+
+    void Run() {
+        const char* begin = Stream::cur;
+        const char* p = begin;
+        const char* end = Stream::end;
+        tokens.clear();
+        pos = 0;
+        for (;;) {
+            p = Scan::spaces(p, end);
+            Token tok;
+            tok.at = p - begin;
+            tok.value = 0;
+            if (p == end) {
+                tok.kind = T_END;
+            } else if (Scan::isDigit(*p)) {
+                tok.kind = T_NUMBER;
+                for (const char* q = Scan::numbers(p, end); p < q; p++) tok.value = tok.value * 10 + (*p - '0');
+            } else if (Scan::isWord(*p)) {
+                const char* s = p;
+                p = Scan::words(p, end);
+                tok.kind = Keyword::word(s, p - s);
+                if (tok.kind == T_NAME) tok.value = Symbol::intern(s, p - s);
+            } else if (p + 1 < end && (tok.kind = Keyword::two(p[0], p[1])) != T_END) {
+                p += 2;
+            } else {
+                // a char that starts no token reads as the end
+                tok.kind = Keyword::one(*p);
+                if (tok.kind != T_END) p++;
+            }
+            tokens.push_back(tok);
+            if (tok.kind == T_END) break;
+        }
+    }
+
+    inline token_type peek() {
+        return tokens[pos].kind;
+    }
+
+    inline const Token& get() {
+        const Token& ret = tokens[pos];
+        if (ret.kind != T_END) pos++;
+        return ret;
+    }
+
+    inline std::string spell(const Token& tok) {
+        if (tok.kind == T_NAME) return Symbol::name(tok.value);
+        if (tok.kind == T_NUMBER) return std::to_string(tok.value);
+        return spelling[tok.kind];
+    }
+}
+
+enum op_type : uint8_t {
+    PLUS,
+    MINUS,
+    TIMES,
+    DIVIDE,
+    MODULO,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+    XOR,
+    AND,
+    OR,
+    ASSIGN,
+    NOT,
+    SHIFT_LEFT,
+    SHIFT_RIGHT
+};
+
+struct Tree;
+struct Object;
+
+// the whole program lives in a handful of flat pools and refers to itself
+// by 32-bit indices only, so it can be copied or written out as it is.
+namespace Ast {
+    template <typename T> std::vector<T>& pool();
+    template <> std::vector<uint32_t>& pool<uint32_t>();
+    template <> std::vector<Object>& pool<Object>();
+    template <> std::vector<op_type>& pool<op_type>();
+    template <> std::vector<int>& pool<int>();
+
+    Tree* at(uint32_t id);
+}
+
+// count elements of Ast::pool<T>() starting at first
+template <typename T>
+struct Range {
+    uint32_t first;
+    uint32_t count;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return Ast::pool<T>()[first + i]; }
+    T& front() const { return (*this)[0]; }
+    T& back() const { return (*this)[count - 1]; }
+    T* begin() const { return Ast::pool<T>().data() + first; }
+    T* end() const { return begin() + count; }
+};
+
+// a Range of node indices that reads as Tree*; index 0 reads as nullptr
+struct Children {
+    struct iterator {
+        const uint32_t* p;
+        Tree* operator*() const { return Ast::at(*p); }
+        iterator& operator++() { ++p; return *this; }
+        bool operator!=(const iterator& o) const { return p != o.p; }
+    };
+
+    uint32_t first;
+    uint32_t count;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Tree* operator[](size_t i) const { return Ast::at(Ast::pool<uint32_t>()[first + i]); }
+    Tree* front() const { return (*this)[0]; }
+    Tree* back() const { return (*this)[count - 1]; }
+    iterator begin() const { return iterator{Ast::pool<uint32_t>().data() + first}; }
+    iterator end() const { return iterator{Ast::pool<uint32_t>().data() + first + count}; }
+};
+
+struct Object {
+    obj_type type;
+    int name;  // symbol id
+    Range<int> dims;
+    Range<int> strides;  // ARRAY: set by Resolver, in ints
+    int value;
+    bool global;  // set by Resolver: offset is into the globals, not the frame
+    int slot;     // set by Resolver: int offset, for FUNCTION the index in
+                  // Resolver::functions, -1 for putchar
+    Object(obj_type type):type(type), name(0), dims(), strides(), value(0), global(false), slot(-1) {
+    }
+    Object(obj_type type, int val):type(type), name(0), dims(), strides(), value(val), global(false), slot(-1) {
+    }
+
+};
+
+struct Tree {
+    stmt_type type;
+    int name;  // FUNCDEF: symbol id
+    Children children;
+    Range<Object> vars;
+    Range<op_type> ops;
+    int frame;  // FUNCDEF: ints of locals, filled by Resolver
+    uint32_t body;  // FUNCDEF: token of the body while it is not parsed yet, else 0
+};
+
+namespace Ast {
+    struct Pools {
+        std::vector<Tree> nodes;
+        std::vector<uint32_t> kids;
+        std::vector<Object> objects;
+        std::vector<op_type> ops;
+        std::vector<int> ints;
+    };
+
+    Pools pools;  // the program
+    // where this thread's parser builds to. workers of Parser::Program build
+    // a part of the program each, which merge() moves into the pools
+    thread_local Pools* build = &pools;
+
+    template <> std::vector<uint32_t>& pool<uint32_t>() { return pools.kids; }
+    template <> std::vector<Object>& pool<Object>() { return pools.objects; }
+    template <> std::vector<op_type>& pool<op_type>() { return pools.ops; }
+    template <> std::vector<int>& pool<int>() { return pools.ints; }
+
+    // a node's lists are only known once it is finished, so the parser
+    // stacks them up here and close() moves them into the pools in one run
+    thread_local std::vector<uint32_t> open_kids;
+    thread_local std::vector<Object> open_vars;
+    thread_local std::vector<op_type> open_ops;
+
+    struct Mark {
+        size_t kids, vars, ops;
+    };
+
+    inline Tree* at(uint32_t id) {
+        return id == 0 ? nullptr : &pools.nodes[id];
+    }
+
+    inline void init(Pools& to = pools) {
+        to.nodes.assign(1, Tree());  // index 0 is no node
+    }
+
+    // room for everything n tokens can ever parse into, so that nothing
+    // moves when more of the program is parsed while it runs. every node
+    // but a STATEMENT takes a token of its own, a FOR adds at most three
+    // empty children, every object takes a name or a number, and strides
+    // are never more than the dims they come from
+    inline void reserve(size_t n) {
+        pools.nodes.reserve(2 * n + 2);
+        pools.kids.reserve(5 * n + 2);
+        pools.objects.reserve(n);
+        pools.ops.reserve(n);
+        pools.ints.reserve(2 * n);
+    }
+
+    inline Mark open() {
+        return Mark{open_kids.size(), open_vars.size(), open_ops.size()};
+    }
+
+    template <typename T>
+    inline void move(std::vector<T>& from, size_t mark, std::vector<T>& to, uint32_t& first, uint32_t& count) {
+        first = to.size();
+        count = from.size() - mark;
+        to.insert(to.end(), from.begin() + mark, from.end());
+        from.erase(from.begin() + mark, from.end());
+    }
+
+    inline uint32_t close(stmt_type type, const Mark& mark, int name = 0) {
+        Pools& to = *build;
+        Tree node = Tree();
+        node.type = type;
+        node.name = name;
+        move(open_kids, mark.kids, to.kids, node.children.first, node.children.count);
+        move(open_vars, mark.vars, to.objects, node.vars.first, node.vars.count);
+        move(open_ops, mark.ops, to.ops, node.ops.first, node.ops.count);
+        to.nodes.push_back(node);
+        return to.nodes.size() - 1;
+    }
+
+    // dims of a variable are parsed in one run, so they can go straight in
+    inline void dim(Object& obj, int n) {
+        std::vector<int>& ints = build->ints;
+        if (obj.dims.empty()) obj.dims.first = ints.size();
+        ints.push_back(n);
+        obj.dims.count++;
+    }
+
+    // appends a part built by another thread to the pools, moving every
+    // index in it along, and returns how far its node ids moved
+    inline uint32_t merge(Pools& part) {
+        uint32_t nodes_at = pools.nodes.size() - 1;
+        uint32_t kids_at = pools.kids.size();
+        uint32_t objects_at = pools.objects.size();
+        uint32_t ops_at = pools.ops.size();
+        uint32_t ints_at = pools.ints.size();
+        for (size_t i = 1; i < part.nodes.size(); i++) {
+            Tree node = part.nodes[i];
+            node.children.first += kids_at;
+            node.vars.first += objects_at;
+            node.ops.first += ops_at;
+            pools.nodes.push_back(node);
+        }
+        for (auto id : part.kids) pools.kids.push_back(id == 0 ? 0 : id + nodes_at);
+        for (auto obj : part.objects) {
+            obj.dims.first += ints_at;
+            pools.objects.push_back(obj);
+        }
+        pools.ops.insert(pools.ops.end(), part.ops.begin(), part.ops.end());
+        pools.ints.insert(pools.ints.end(), part.ints.begin(), part.ints.end());
+        return nodes_at;
+    }
+
+    inline void release() {
+        pools = Pools();
+    }
+}
+
+
+Tree* Root;
+
+
+namespace Parser {
+    bool lazy;  // --lazy: leave function bodies to the first call
+    unsigned threads = 1;  // --parse-threads
+    // --parse-threads=0 takes one per core, but no more than this many
+    const unsigned MAX_THREADS = 8;
+    // below this many tokens a program is parsed by one thread
+    const size_t SPLIT = 1 << 15;
+    bool split;  // function bodies are parsed after the rest, by threads
+    std::vector<uint32_t> pending;  // FUNCDEFs whose bodies are still to parse
+
+    // the thread count --parse-threads=n asks for. hardware_concurrency()
+    // is 0 when it cannot tell, and then bodies are parsed by one thread
+    inline unsigned count(int n) {
+        if (n > 0) return n;
+        if (n < 0) return 1;
+        unsigned cores = std::thread::hardware_concurrency();
+        return cores == 0 ? 1 : std::min(cores, MAX_THREADS);
+    }
+
+    uint32_t Program();
+    uint32_t Funcdef(int);
+    uint32_t Vardef(int);
+    uint32_t Statement();
+    uint32_t Statements();
+    uint32_t Expression();
+    uint32_t Return();
+    uint32_t If();
+    uint32_t While();
+    uint32_t For();
+    uint32_t Unit0();
+    uint32_t Unary();
+    uint32_t Binary(int);
+
+    inline void match(token_type kind) {
+        const Lexer::Token& tok = Lexer::get();
+        if (tok.kind != kind)
+            throw std::string("Match ") + Lexer::spelling[kind] + " Failed! " + Lexer::spell(tok);
+    }
+
+    // a name spelled word, for the fixed header
+    inline void match(const char* word) {
+        const Lexer::Token& tok = Lexer::get();
+        if (tok.kind != T_NAME || tok.value != Symbol::intern(word))
+            throw std::string("Match ") + word + " Failed! " + Lexer::spell(tok);
+    }
+
+    // the symbol id of the name that comes next
+    inline int name() {
+        const Lexer::Token& tok = Lexer::get();
+        if (tok.kind != T_NAME)
+            throw std::string("Match name Failed! ") + Lexer::spell(tok);
+        return tok.value;
+    }
+
+    inline void var(obj_type type, int name) {
+        Ast::open_vars.emplace_back(type);
+        Ast::open_vars.back().name = name;
+    }
+
+    void Bodies();
+
+    uint32_t Program() {
+        Ast::Mark mark = Ast::open();
+        match(T_HASH), match("include"), match(T_LESS), match("iostream"), match(T_GREATER);
+        match(T_HASH), match("include"), match(T_LESS), match("cstdio"), match(T_GREATER);
+        match("using"), match("namespace"), match("std"), match(T_SEMICOLON);
+        split = !lazy && threads > 1 && Lexer::tokens.size() >= SPLIT;
+        pending.clear();
+        try {
+            while (Lexer::peek() != T_END) {
+                match(T_INT);
+                int id = name();
+                if (Lexer::peek() == T_LPAREN) {
+                    Ast::open_kids.push_back(Funcdef(id));
+                } else {
+                    Ast::open_kids.push_back(Vardef(id));
+                    match(T_SEMICOLON);
+                }
+            }
+        } catch (std::string) {
+            // an error in a body before this one is the one to report
+            if (split) Bodies();
+            throw;
+        }
+        if (split) Bodies();
+        return Ast::close(PROGRAM, mark);
+    }
+
+    uint32_t Vardef(int id) {
+        Ast::Mark mark = Ast::open();
+        var(VARIABLE, id);
+        while (Lexer::peek() != T_SEMICOLON) {
+            if (Lexer::peek() == T_LBRACKET) {
+                Ast::open_vars.back().type = ARRAY;
+                while (Lexer::peek() == T_LBRACKET) {
+                    match(T_LBRACKET);
+                    const Lexer::Token& tok = Lexer::get();
+                    if (tok.kind != T_NUMBER)
+                        throw std::string("Match number Failed! ") + Lexer::spell(tok);
+                    Ast::dim(Ast::open_vars.back(), tok.value);
+                    match(T_RBRACKET);
+                }
+            } else {
+                match(T_COMMA);
+                var(VARIABLE, name());
+            }
+        }
+        return Ast::close(VARDEF, mark);
+    }
+
+    uint32_t Funcdef(int id) {
+        Ast::Mark mark = Ast::open();
+        match(T_LPAREN);
+        if (Lexer::peek() != T_RPAREN) {
+            match(T_INT);
+            var(VARIABLE, name());
+            while (Lexer::peek() != T_RPAREN) {
+                match(T_COMMA), match(T_INT);
+                var(VARIABLE, name());
+            }
+        }
+        match(T_RPAREN);
+        if (!lazy && !split) {
+            Ast::open_kids.push_back(Statements());
+            return Ast::close(FUNCDEF, mark, id);
+        }
+        uint32_t body = Lexer::pos;
+        match(T_LBRACE);
+        for (int depth = 1; depth > 0; ) {
+            token_type kind = Lexer::peek();
+            // a split body is parsed all the same, and fails where it fails
+            if (kind == T_END && lazy) match(T_RBRACE);
+            if (kind == T_END) break;
+            Lexer::get();
+            if (kind == T_LBRACE) depth++;
+            else if (kind == T_RBRACE) depth--;
+        }
+        uint32_t ret = Ast::close(FUNCDEF, mark, id);
+        Ast::build->nodes[ret].body = body;
+        if (split) pending.push_back(ret);
+        return ret;
+    }
+
+    // gives a skipped FUNCDEF the body parsed for it
+    inline void attach(Tree* cur, uint32_t body) {
+        cur->children.first = Ast::pools.kids.size();
+        cur->children.count = 1;
+        Ast::pools.kids.push_back(body);
+        cur->body = 0;
+    }
+
+    // parses the body a lazy Funcdef skipped over
+    void Body(Tree* cur) {
+        size_t saved = Lexer::pos;
+        Lexer::pos = cur->body;
+        uint32_t body = Statements();
+        Lexer::pos = saved;
+        attach(cur, body);
+    }
+
+    // parses the pending bodies in runs of about the same number of tokens,
+    // one run per thread, each into pools of its own. the runs are merged
+    // in source order, and the first error in source order is the one thrown
+    void Bodies() {
+        size_t n = pending.size();
+        if (n == 0) return;
+        std::vector<size_t> first(1, 0);
+        size_t from = Ast::at(pending[0])->body;
+        size_t span = (Lexer::tokens.size() - from) / threads + 1;
+        for (size_t i = 1; i < n; i++) {
+            if (Ast::at(pending[i])->body - from >= span * first.size()) first.push_back(i);
+        }
+        first.push_back(n);
+        size_t runs = first.size() - 1;
+        std::vector<Ast::Pools> parts(runs);
+        std::vector<uint32_t> bodies(n);
+        std::vector<std::string> errors(runs);
+        std::vector<char> failed(runs, 0);
+        auto run = [&](size_t k) {
+            Ast::build = &parts[k];
+            Ast::init(parts[k]);
+            try {
+                for (size_t i = first[k]; i < first[k + 1]; i++) {
+                    Lexer::pos = Ast::at(pending[i])->body;
+                    bodies[i] = Statements();
+                }
+            } catch (std::string s) {
+                errors[k] = s;
+                failed[k] = 1;
+            }
+            Ast::build = &Ast::pools;
+        };
+        size_t saved = Lexer::pos;
+        std::vector<std::thread> workers;
+        for (size_t k = 1; k < runs; k++) workers.emplace_back(run, k);
+        run(0);
+        for (auto& t : workers) t.join();
+        Lexer::pos = saved;
+        for (size_t k = 0; k < runs; k++) {
+            if (failed[k]) throw errors[k];
+        }
+        for (size_t k = 0; k < runs; k++) {
+            uint32_t shift = Ast::merge(parts[k]);
+            for (size_t i = first[k]; i < first[k + 1]; i++) attach(Ast::at(pending[i]), bodies[i] + shift);
+        }
+        pending.clear();
+    }
+
+    // one statement of a block, or the body of a STATEMENT
+    inline uint32_t Item() {
+        uint32_t ret;
+        switch (Lexer::peek()) {
+            case T_INT:
+                match(T_INT);
+                ret = Vardef(name());
+                match(T_SEMICOLON);
+                return ret;
+            case T_IF:
+                match(T_IF);
+                return If();
+            case T_FOR:
+                match(T_FOR);
+                return For();
+            case T_WHILE:
+                match(T_WHILE);
+                return While();
+            case T_RETURN:
+                match(T_RETURN);
+                ret = Return();
+                match(T_SEMICOLON);
+                return ret;
+            case T_LBRACE:
+                return Statements();
+            default:
+                ret = Expression();
+                match(T_SEMICOLON);
+                return ret;
+        }
+    }
+
+    uint32_t Statements() {
+        Ast::Mark mark = Ast::open();
+        match(T_LBRACE);
+        while (Lexer::peek() != T_RBRACE) {
+            if (Lexer::peek() == T_END) match(T_RBRACE);
+            Ast::open_kids.push_back(Item());
+        }
+        match(T_RBRACE);
+        return Ast::close(STATEMENTS, mark);
+    }
+
+    uint32_t Statement() {
+        Ast::Mark mark = Ast::open();
+        Ast::open_kids.push_back(Item());
+        return Ast::close(STATEMENT, mark);
+    }
+
+    uint32_t If() {
+        Ast::Mark mark = Ast::open();
+        stmt_type type = IF;
+        match(T_LPAREN);
+        Ast::open_kids.push_back(Expression());
+        match(T_RPAREN);
+        Ast::open_kids.push_back(Statement());
+        if (Lexer::peek() == T_ELSE) {
+            match(T_ELSE);
+            type = IF_ELSE;
+            Ast::open_kids.push_back(Statement());
+        }
+        return Ast::close(type, mark);
+    }
+
+    uint32_t For() {
+        Ast::Mark mark = Ast::open();
+        match(T_LPAREN);
+        if (Lexer::peek() != T_SEMICOLON) {
+            if (Lexer::peek() == T_INT) {
+                match(T_INT);
+                Ast::open_kids.push_back(Vardef(name()));
+            } else {
+                Ast::open_kids.push_back(Expression());
+            }
+        } else Ast::open_kids.push_back(0);
+        match(T_SEMICOLON);
+        if (Lexer::peek() != T_SEMICOLON) {
+            Ast::open_kids.push_back(Expression());
+        } else Ast::open_kids.push_back(0);
+        match(T_SEMICOLON);
+        if (Lexer::peek() != T_RPAREN) {
+            Ast::open_kids.push_back(Expression());
+        } else Ast::open_kids.push_back(0);
+        match(T_RPAREN);
+        Ast::open_kids.push_back(Statement());
+        return Ast::close(FOR, mark);
+    }
+
+    uint32_t While() {
+        Ast::Mark mark = Ast::open();
+        match(T_LPAREN);
+        Ast::open_kids.push_back(Expression());
+        match(T_RPAREN);
+        Ast::open_kids.push_back(Statement());
+        return Ast::close(WHILE, mark);
+    }
+
+    uint32_t Return() {
+        Ast::Mark mark = Ast::open();
+        Ast::open_kids.push_back(Expression());
+        return Ast::close(RETURN, mark);
+    }
+
+    inline op_type op(token_type kind) {
+        return op_type(kind - T_PLUS);
+    }
+
+    // binary operators by the UNITn level they build, 0 if kind is not one
+    inline int level(token_type kind) {
+        switch (kind) {
+            case T_TIMES: case T_DIVIDE: case T_MODULO: return 2;
+            case T_PLUS: case T_MINUS: return 3;
+            case T_LESS: case T_LESS_EQUAL: case T_GREATER: case T_GREATER_EQUAL: return 4;
+            case T_EQUAL: case T_NOT_EQUAL: return 5;
+            case T_XOR: return 6;
+            case T_AND: return 7;
+            case T_OR: return 8;
+            case T_ASSIGN: return 9;
+            default: return 0;
+        }
+    }
+
+    // only levels that actually see an operator get a node, so a bare
+    // operand comes back as its UNIT0 and `(e)` as the tree of e
+    uint32_t Expression() {
+        uint32_t first = Binary(9);
+        if (Lexer::peek() != T_SHIFT_LEFT && Lexer::peek() != T_SHIFT_RIGHT) return first;
+        Ast::Mark mark = Ast::open();
+        Ast::open_kids.push_back(first);
+        while (Lexer::peek() == T_SHIFT_LEFT || Lexer::peek() == T_SHIFT_RIGHT) {
+            Ast::open_ops.push_back(op(Lexer::get().kind));
+            Ast::open_kids.push_back(Binary(9));
+        }
+        return Ast::close(EXPR, mark);
+    }
+
+    uint32_t Unit0() {
+        Ast::Mark mark = Ast::open();
+        const Lexer::Token& tok = Lexer::get();
+        if (tok.kind == T_CIN) {
+            Ast::open_vars.emplace_back(CIN);
+        } else if (tok.kind == T_COUT) {
+            Ast::open_vars.emplace_back(COUT);
+        } else if (tok.kind == T_ENDL) {
+            Ast::open_vars.emplace_back(ENDL);
+        } else if (tok.kind == T_LPAREN) {
+            uint32_t inner = Expression();
+            match(T_RPAREN);
+            return inner;
+        } else if (tok.kind == T_NUMBER) { // vars[0].type = VALUE
+            Ast::open_vars.emplace_back(VALUE, tok.value);
+        } else if (tok.kind == T_NAME) {
+            if (Lexer::peek() == T_LPAREN) {
+                var(FUNCTION, tok.value); // !children.empty() && vars
+                match(T_LPAREN);
+                if (Lexer::peek() != T_RPAREN) {
+                    Ast::open_kids.push_back(Expression());
+                    while (Lexer::peek() != T_RPAREN) {
+                        match(T_COMMA);
+                        Ast::open_kids.push_back(Expression());
+                    }
+                }
+                match(T_RPAREN);
+            } else {
+                var(VARIABLE, tok.value);
+            }
+        } else {
+            throw std::string("Unexpected ") + Lexer::spell(tok);
+        }
+        if (Lexer::peek() == T_LBRACKET) {
+            Ast::open_vars.back().type = ARRAY;
+            while (Lexer::peek() == T_LBRACKET) {
+                match(T_LBRACKET);
+                Ast::open_kids.push_back(Expression());
+                match(T_RBRACKET);
+            }
+        }
+        return Ast::close(UNIT0, mark);
+    }
+
+    uint32_t Unary() {
+        token_type kind = Lexer::peek();
+        if (kind != T_PLUS && kind != T_MINUS && kind != T_NOT) return Unit0();
+        Ast::Mark mark = Ast::open();
+        while ((kind = Lexer::peek()) == T_PLUS || kind == T_MINUS || kind == T_NOT) {
+            Lexer::get();
+            Ast::open_ops.push_back(op(kind));
+        }
+        Ast::open_kids.push_back(Unit0());
+        return Ast::close(UNIT1, mark);
+    }
+
+    // precedence climbing over the operators of level <= top. a run of
+    // operators of one level becomes one node, as the old UnitN loops built
+    uint32_t Binary(int top) {
+        uint32_t ret = Unary();
+        int l;
+        while ((l = level(Lexer::peek())) != 0 && l <= top) {
+            Ast::Mark mark = Ast::open();
+            Ast::open_kids.push_back(ret);
+            while (level(Lexer::peek()) == l) {
+                Ast::open_ops.push_back(op(Lexer::get().kind));
+                Ast::open_kids.push_back(Binary(l - 1));
+            }
+            ret = Ast::close(stmt_type(UNIT0 + l), mark);
+        }
+        return ret;
+    }
+}
+
+// binds every variable to an int offset so that no engine looks a name up
+// at run time: globals from the start of the global memory, locals from the
+// frame pointer of the running function. arrays are laid out inline with
+// their strides. scopes mirror the ones the runner used to push and pop:
+// function parameters, every block, every statement and the init clause of
+// a for. a block's storage is given back when it closes, so sibling blocks
+// share offsets and a frame is as large as its deepest nesting.
+namespace Resolver {
+    void Program(Tree*);
+    void Function(Tree*);
+    void Node(Tree*);
+
+    // by symbol id, the declarations in scope that carry that name, the
+    // innermost last. globals sit at the bottom
+    std::vector<std::vector<const Object*> > visible;
+    // symbols declared since the start of each open scope
+    std::vector<int> declared;
+    std::vector<size_t> scopes;
+    int global_size;
+    int frame, frame_size;
+
+    // FUNCDEFs in source order; a call's obj.slot indexes this
+    std::vector<Tree*> functions;
+    std::vector<int> function_table;  // by symbol id, -1 if not a function
+
+    // index in functions of the function called name, -1 if there is none
+    inline int function(const char* name) {
+        int id = Symbol::intern(name);
+        return size_t(id) < function_table.size() ? function_table[id] : -1;
+    }
+
+    inline void open() {
+        scopes.push_back(declared.size());
+    }
+
+    inline void close() {
+        for (size_t i = scopes.back(); i < declared.size(); i++) visible[declared[i]].pop_back();
+        declared.resize(scopes.back());
+        scopes.pop_back();
+    }
+
+    // ints taken by obj
+    inline int size(const Object& obj) {
+        int n = 1;
+        for (auto d : obj.dims) n *= d;
+        return n;
+    }
+
+    inline void layout(Object& obj, int& top) {
+        obj.slot = top;
+        if (obj.type == ARRAY) {
+            std::vector<int>& ints = Ast::pools.ints;
+            obj.strides.first = ints.size();
+            obj.strides.count = obj.dims.size();
+            ints.resize(ints.size() + obj.strides.count);
+            int n = 1;
+            for (size_t i = obj.dims.size(); i-- > 0; ) {
+                obj.strides[i] = n;
+                n *= obj.dims[i];
+            }
+        }
+        top += size(obj);
+    }
+
+    inline void declare(Object& obj) {
+        obj.global = false;
+        layout(obj, frame);
+        frame_size = std::max(frame_size, frame);
+        visible[obj.name].push_back(&obj);
+        declared.push_back(obj.name);
+    }
+
+    inline void bind(Object& obj) {
+        if (visible[obj.name].empty())
+            throw std::string("Undefined variable ") + Symbol::name(obj.name);
+        const Object* found = visible[obj.name].back();
+        obj.global = found->global;
+        obj.slot = found->slot;
+        obj.strides = found->strides;
+    }
+
+    inline void call(Object& obj) {
+        if (obj.name == Symbol::intern("putchar")) {
+            obj.slot = -1;
+            return;
+        }
+        if (function_table[obj.name] < 0)
+            throw std::string("Undefined function ") + Symbol::name(obj.name);
+        obj.slot = function_table[obj.name];
+    }
+
+    void Program(Tree* cur) {
+        visible.assign(Symbol::names.size(), std::vector<const Object*>());
+        function_table.assign(Symbol::names.size(), -1);
+        for (auto chd : cur->children) {
+            if (chd->type == FUNCDEF) {
+                function_table[chd->name] = functions.size();
+                functions.push_back(chd);
+            }
+        }
+        global_size = 0;
+        for (auto chd : cur->children) {
+            if (chd->type == VARDEF) {
+                for (auto& obj : chd->vars) {
+                    obj.global = true;
+                    layout(obj, global_size);
+                    visible[obj.name].push_back(&obj);
+                }
+            }
+        }
+        for (auto chd : cur->children) {
+            if (chd->type == FUNCDEF && chd->body == 0) Function(chd);
+        }
+    }
+
+    void Function(Tree* cur) {
+        frame = frame_size = 0;
+        open();
+        for (auto& obj : cur->vars) declare(obj);
+        for (auto chd : cur->children) Node(chd);
+        close();
+        cur->frame = frame_size;
+    }
+
+    void Node(Tree* cur) {
+        if (cur == nullptr) return;
+        int saved;
+        switch (cur->type) {
+            case VARDEF:
+                for (auto& obj : cur->vars) declare(obj);
+                break;
+            case STATEMENTS:
+            case STATEMENT:
+            case FOR:
+                saved = frame;
+                open();
+                for (auto chd : cur->children) Node(chd);
+                close();
+                frame = saved;
+                break;
+            case UNIT0:
+                if (cur->vars.front().type == VARIABLE || cur->vars.front().type == ARRAY)
+                    bind(cur->vars.front());
+                else if (cur->vars.front().type == FUNCTION)
+                    call(cur->vars.front());
+                for (auto chd : cur->children) Node(chd);
+                break;
+            default:
+                for (auto chd : cur->children) Node(chd);
+        }
+    }
+}
+
+namespace Runner {
+    const size_t STACK = 1 << 24;  // ints, the Optimizer keeps frames within it
+}
+
+// works out before the program runs what does not depend on it: operator
+// nodes whose operands are constant, from the left as far as they are, and
+// reads of a local that its block sets once from a constant. a folded node
+// becomes a UNIT0 VALUE in the object of one of its constant operands, so
+// the pools never grow. arithmetic wraps as it does at run time, and a
+// division by 0, INT_MIN / -1 or a shift out of range is left to run time.
+// then drops what cannot matter: locals nobody reads, statements after a
+// return, ifs and whiles decided by a constant and expressions whose value
+// is thrown away. dropping only shortens lists in place. before all that,
+// for the tree walker, calls of small functions that are not recursive
+// take a copy of the body in place of the call. last, a return of a call
+// becomes a TAILCALL, which runs the callee in the frame it returns from.
+namespace Optimizer {
+    bool fold = true;  // --no-fold
+    bool dce = true;   // --no-dce
+    bool tail = true;  // --no-tail
+    bool stats;        // --stats: what the passes did, on stderr
+    size_t limit = 40;  // --inline=N: most nodes of a body to inline, 0 for none
+    // most ints inlining adds to a frame. a recursive function has a frame
+    // per level of the recursion, so it gets far less
+    const int GROWTH = 1 << 16, RECURSIVE_GROWTH = 16;
+    size_t removed, unused;  // nodes and locals dropped
+    size_t inlined;          // calls expanded
+
+    void Node(Tree*);
+
+    inline bool constant(const Tree* cur) {
+        return cur != nullptr && cur->type == UNIT0 && cur->vars.front().type == VALUE;
+    }
+
+    inline int value(const Tree* cur) {
+        return cur->vars.front().value;
+    }
+
+    // cur becomes the constant x, kept in the object of kid
+    inline void become(Tree* cur, Tree* kid, int x) {
+        kid->vars.front().value = x;
+        cur->type = UNIT0;
+        cur->vars = kid->vars;
+        cur->children.count = 0;
+        cur->ops.count = 0;
+    }
+
+    // a op b as the runner works it out, false if that is up to run time
+    inline bool apply(op_type op, int a, int b, int& ret) {
+        uint32_t x = a, y = b;
+        switch (op) {
+            case PLUS: ret = int(x + y); return true;
+            case MINUS: ret = int(x - y); return true;
+            case TIMES: ret = int(x * y); return true;
+            case DIVIDE:
+            case MODULO:
+                if (b == 0 || (a == INT_MIN && b == -1)) return false;
+                ret = op == DIVIDE ? a / b : a % b;
+                return true;
+            case LESS: ret = a < b; return true;
+            case LESS_EQUAL: ret = a <= b; return true;
+            case GREATER: ret = a > b; return true;
+            case GREATER_EQUAL: ret = a >= b; return true;
+            case EQUAL: ret = a == b; return true;
+            case NOT_EQUAL: ret = a != b; return true;
+            case XOR: ret = a ^ b; return true;
+            case AND: ret = a && b; return true;
+            case OR: ret = a || b; return true;
+            case SHIFT_LEFT:
+            case SHIFT_RIGHT:
+                if (b < 0 || b > 31) return false;
+                ret = op == SHIFT_LEFT ? int(x << b) : a >> b;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline void unary(Tree* cur) {
+        Tree* kid = cur->children[0];
+        if (!constant(kid)) return;
+        int x = value(kid);
+        for (size_t i = cur->ops.size(); i-- > 0; ) {
+            if (cur->ops[i] == MINUS) x = int(0u - uint32_t(x));
+            else if (cur->ops[i] == NOT) x = !x;
+        }
+        become(cur, kid, x);
+    }
+
+    // folds the constant operands a run of operators starts with. the
+    // result goes to the last of them, which then starts the run
+    inline void chain(Tree* cur) {
+        if (!constant(cur->children[0])) return;
+        int ret = value(cur->children[0]);
+        size_t k = 0;
+        for (; k < cur->ops.size(); k++) {
+            op_type op = cur->ops[k];
+            // past a decided && or || nothing more is evaluated
+            if ((op == AND && ret == 0) || (op == OR && ret != 0)) {
+                become(cur, cur->children[k], op == OR);
+                return;
+            }
+            int next;
+            if (!constant(cur->children[k + 1]) || !apply(op, ret, value(cur->children[k + 1]), next)) break;
+            ret = next;
+        }
+        if (k == 0) return;
+        if (k == cur->ops.size()) {
+            become(cur, cur->children[k], ret);
+            return;
+        }
+        cur->children[k]->vars.front().value = ret;
+        cur->children.first += k;
+        cur->children.count -= k;
+        cur->ops.first += k;
+        cur->ops.count -= k;
+    }
+
+    inline bool local(const Tree* cur, int slot) {
+        if (cur == nullptr || cur->type != UNIT0) return false;
+        const Object& obj = cur->vars.front();
+        return (obj.type == VARIABLE || obj.type == ARRAY) && !obj.global && obj.slot == slot;
+    }
+
+    // uses of the local at slot under cur
+    void uses(Tree* cur, int slot, int& reads, int& writes);
+
+    inline void target(Tree* cur, int slot, int& reads, int& writes) {
+        if (local(cur, slot)) {
+            writes++;
+            for (auto chd : cur->children) uses(chd, slot, reads, writes);
+        } else if (cur != nullptr && cur->type != UNIT0) {
+            // not a plain variable: count any use in it as a store
+            int n = 0;
+            uses(cur, slot, n, writes);
+            writes += n;
+        } else {
+            uses(cur, slot, reads, writes);
+        }
+    }
+
+    void uses(Tree* cur, int slot, int& reads, int& writes) {
+        if (cur == nullptr) return;
+        if (local(cur, slot)) reads++;
+        size_t n = cur->children.size();
+        if (cur->type == UNIT9) {
+            for (size_t i = 0; i + 1 < n; i++) target(cur->children[i], slot, reads, writes);
+            uses(cur->children[n - 1], slot, reads, writes);
+        } else if (cur->type == EXPR && cur->children[0]->type == UNIT0 && cur->children[0]->vars.front().type == CIN) {
+            for (size_t i = 1; i < n; i++) target(cur->children[i], slot, reads, writes);
+        } else {
+            for (auto chd : cur->children) uses(chd, slot, reads, writes);
+        }
+    }
+
+    void replace(Tree* cur, int slot, int x, int& n) {
+        if (cur == nullptr) return;
+        if (local(cur, slot) && cur->vars.front().type == VARIABLE) {
+            cur->vars.front().type = VALUE;
+            cur->vars.front().value = x;
+            n++;
+        }
+        for (auto chd : cur->children) replace(chd, slot, x, n);
+    }
+
+    // the local at slot is declared by statement d of block. while the
+    // block runs the slot is no one else's, so if a later statement sets it
+    // to a constant and no other statement stores to it or reads it before
+    // that, every read after it is that constant
+    inline bool propagate(Tree* block, size_t d, int slot) {
+        size_t set = 0;
+        int x = 0;
+        for (size_t i = d + 1; i < block->children.size(); i++) {
+            Tree* cur = block->children[i];
+            if (set == 0 && cur->type == UNIT9 && cur->children.size() == 2
+                && local(cur->children[0], slot) && constant(cur->children[1])) {
+                set = i;
+                x = value(cur->children[1]);
+                continue;
+            }
+            int reads = 0, writes = 0;
+            uses(cur, slot, reads, writes);
+            if (writes > 0 || (reads > 0 && set == 0)) return false;
+        }
+        if (set == 0) return false;
+        int n = 0;
+        for (size_t i = set + 1; i < block->children.size(); i++) {
+            int before = n;
+            replace(block->children[i], slot, x, n);
+            if (n > before) Node(block->children[i]);
+        }
+        return n > 0;
+    }
+
+    inline void block(Tree* cur) {
+        for (bool again = true; again; ) {
+            again = false;
+            for (size_t d = 0; d < cur->children.size(); d++) {
+                Tree* def = cur->children[d];
+                if (def->type != VARDEF) continue;
+                for (auto& obj : def->vars) {
+                    if (obj.type == VARIABLE && propagate(cur, d, obj.slot)) again = true;
+                }
+            }
+        }
+    }
+
+    inline uint32_t id(const Tree* cur) {
+        return cur - Ast::pools.nodes.data();
+    }
+
+    size_t count(const Tree* cur) {
+        if (cur == nullptr) return 0;
+        size_t n = 1;
+        for (auto chd : cur->children) n += count(chd);
+        return n;
+    }
+
+    inline bool expression(const Tree* cur) {
+        return cur->type == EXPR || (cur->type >= UNIT0 && cur->type <= UNIT9);
+    }
+
+    // an expression that does nothing but give its value. a division
+    // could trap, so it counts as doing something
+    bool pure(const Tree* cur) {
+        if (cur == nullptr) return true;
+        switch (cur->type) {
+            case UNIT0:
+                if (cur->vars.front().type != VALUE && cur->vars.front().type != VARIABLE
+                    && cur->vars.front().type != ARRAY) return false;
+                break;
+            case UNIT2:
+                for (auto op : cur->ops) {
+                    if (op == DIVIDE || op == MODULO) return false;
+                }
+                break;
+            case EXPR: case UNIT1: case UNIT3: case UNIT4:
+            case UNIT5: case UNIT6: case UNIT7: case UNIT8:
+                break;
+            default:
+                return false;
+        }
+        for (auto chd : cur->children) {
+            if (!pure(chd)) return false;
+        }
+        return true;
+    }
+
+    void strip(Tree* cur, int slot);
+
+    // from statement from of the list cur on, and in every list under
+    // those, a plain store to the local at slot keeps only its right side,
+    // and only if that does something
+    inline void strip(Tree* cur, size_t from, int slot) {
+        uint32_t* list = Ast::pools.kids.data() + cur->children.first;
+        size_t n = from;
+        for (size_t i = from; i < cur->children.count; i++) {
+            Tree* chd = Ast::at(list[i]);
+            if (chd->type == UNIT9 && chd->children.size() == 2 && local(chd->children[0], slot)
+                && chd->children[0]->vars.front().type == VARIABLE) {
+                size_t all = count(chd);
+                chd = chd->children[1];
+                if (pure(chd)) {
+                    removed += all;
+                    continue;
+                }
+                removed += all - count(chd);
+                list[i] = id(chd);
+            }
+            strip(chd, slot);
+            list[n++] = list[i];
+        }
+        cur->children.count = n;
+    }
+
+    void strip(Tree* cur, int slot) {
+        if (cur == nullptr) return;
+        if (cur->type == STATEMENTS || cur->type == STATEMENT) {
+            strip(cur, 0, slot);
+            return;
+        }
+        for (auto chd : cur->children) strip(chd, slot);
+    }
+
+    // drops the local obj declared by statement d of block if no later
+    // statement reads it, which also makes the stores to it dead
+    inline bool drop(Tree* block, size_t d, Object& obj) {
+        int reads = 0, writes = 0;
+        for (size_t i = d + 1; i < block->children.size(); i++) uses(block->children[i], obj.slot, reads, writes);
+        if (reads > 0) return false;
+        if (writes > 0) {
+            strip(block, d + 1, obj.slot);
+            writes = 0;
+            for (size_t i = d + 1; i < block->children.size(); i++) uses(block->children[i], obj.slot, reads, writes);
+            if (writes > 0) return false;
+        }
+        Range<Object>& vars = block->children[d]->vars;
+        std::copy(&obj + 1, vars.end(), &obj);
+        vars.count--;
+        unused++;
+        return true;
+    }
+
+    // keeps the statements of a list that can still make a difference
+    inline void prune(Tree* cur) {
+        if (cur->type == STATEMENTS) {
+            for (size_t d = 0; d < cur->children.size(); d++) {
+                Tree* def = cur->children[d];
+                if (def->type != VARDEF) continue;
+                for (size_t i = def->vars.size(); i-- > 0; ) drop(cur, d, def->vars[i]);
+            }
+        }
+        uint32_t* list = Ast::pools.kids.data() + cur->children.first;
+        size_t n = 0;
+        bool returned = false;
+        for (size_t i = 0; i < cur->children.count; i++) {
+            Tree* chd = Ast::at(list[i]);
+            size_t all = count(chd);
+            if (returned) {
+                removed += all;
+                continue;
+            }
+            if ((chd->type == IF || chd->type == IF_ELSE) && constant(chd->children[0])) {
+                // the arm that runs, a STATEMENT around one statement
+                Tree* arm = value(chd->children[0]) ? chd->children[1]
+                          : chd->type == IF_ELSE ? chd->children[2] : nullptr;
+                chd = arm == nullptr || arm->children.empty() ? nullptr : arm->children.front();
+                // a declaration there would go out of scope at once
+                if (chd == nullptr || chd->type == VARDEF) {
+                    removed += all;
+                    continue;
+                }
+                removed += all - count(chd);
+                all = count(chd);
+                list[i] = id(chd);
+            }
+            if ((chd->type == WHILE && constant(chd->children[0]) && value(chd->children[0]) == 0)
+                || (chd->type == VARDEF && (chd->vars.empty() || cur->type == STATEMENT))
+                || (expression(chd) && pure(chd))) {
+                removed += all;
+                continue;
+            }
+            list[n++] = list[i];
+            returned = chd->type == RETURN || chd->type == TAILCALL;
+        }
+        cur->children.count = n;
+    }
+
+    void Node(Tree* cur) {
+        if (cur == nullptr) return;
+        for (auto chd : cur->children) Node(chd);
+        switch (cur->type) {
+            case UNIT1:
+                if (fold) unary(cur);
+                break;
+            case EXPR: case UNIT2: case UNIT3: case UNIT4:
+            case UNIT5: case UNIT6: case UNIT7: case UNIT8:
+                if (fold) chain(cur);
+                break;
+            case STATEMENTS:
+                if (fold) block(cur);
+                if (dce) prune(cur);
+                break;
+            case STATEMENT:
+                if (dce) prune(cur);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void Function(Tree* cur) {
+        for (auto chd : cur->children) Node(chd);
+    }
+
+    // a return of what a call of one of the program's functions gives
+    // becomes a TAILCALL with that call as its child. a copy that expand()
+    // made is not the tail of the function it sits in, so this runs last
+    void Tails(Tree* cur) {
+        if (cur == nullptr || cur->type == INLINE || expression(cur)) return;
+        if (cur->type == RETURN) {
+            Tree* call = cur->children[0];
+            while (call->type >= UNIT1 && call->type <= UNIT9 && call->children.size() == 1 && call->ops.empty())
+                call = call->children[0];
+            if (call->type != UNIT0 || call->vars.front().type != FUNCTION || call->vars.front().slot < 0) return;
+            if (call->children.size() != Resolver::functions[call->vars.front().slot]->vars.size()) return;
+            Ast::pools.kids[cur->children.first] = id(call);
+            cur->type = TAILCALL;
+            return;
+        }
+        for (auto chd : cur->children) Tails(chd);
+    }
 
-namespace Stream {
-    char buffer;
+    std::vector<std::vector<int>> calls;  // by function, the functions it calls
+    std::vector<int> order;               // callees before their callers
+    std::vector<int> index, low, path, component;
+    std::vector<bool> on_path, recursive;
+    std::vector<bool> functional;  // by function: pure, its value depends on its arguments alone
+    int visited, components;
+    std::vector<uint32_t> defs;  // Resolver::functions as indices, which stay valid as the pools grow
+
+    void callees(const Tree* cur, std::vector<int>& out) {
+        if (cur == nullptr) return;
+        if (cur->type == UNIT0 && cur->vars.front().type == FUNCTION && cur->vars.front().slot >= 0)
+            out.push_back(cur->vars.front().slot);
+        for (auto chd : cur->children) callees(chd, out);
+    }
 
-    inline char nxtChar() {
-        if (!buffer) {
-            buffer = getchar();
+    // Tarjan's strongly connected components of the call graph. each one is
+    // finished after all it calls, and one with a cycle is recursive
+    void connect(int f) {
+        index[f] = low[f] = ++visited;
+        path.push_back(f);
+        on_path[f] = true;
+        for (int g : calls[f]) {
+            if (g == f) recursive[f] = true;
+            if (index[g] == 0) {
+                connect(g);
+                low[f] = std::min(low[f], low[g]);
+            } else if (on_path[g]) {
+                low[f] = std::min(low[f], index[g]);
+            }
+        }
+        if (low[f] != index[f]) return;
+        size_t from = path.size();
+        while (path[--from] != f) {}
+        for (size_t i = from; i < path.size(); i++) {
+            on_path[path[i]] = false;
+            if (path.size() - from > 1) recursive[path[i]] = true;
+            component[path[i]] = components;
+            order.push_back(path[i]);
         }
-        return buffer;
+        components++;
+        path.resize(from);
     }
 
-    inline char getChar() {
-        char ret = nxtChar();
-        buffer = 0;
-        return ret;
+    // touches no global, no cin, no cout and no putchar
+    bool clean(const Tree* cur) {
+        if (cur == nullptr) return true;
+        for (auto& obj : cur->vars) {
+            if ((obj.type == VARIABLE || obj.type == ARRAY) && obj.global) return false;
+            if (obj.type == CIN || obj.type == COUT || (obj.type == FUNCTION && obj.slot < 0)) return false;
+        }
+        for (auto chd : cur->children) {
+            if (!clean(chd)) return false;
+        }
+        return true;
     }
 
-}
-
-namespace Lexer {
-    std::string buffer;
-
-    inline int charType(char ch) {
-        if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t') return EMPTY;
-        else if ('0' <= ch && ch <= '9') return DIGIT;
-        else if (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == '_') return ALPHA;
-        else return OTHER;
-    }
-
-    inline std::string nxtLexeme() {
-        if (buffer.empty()) {
-            if (Stream::nxtChar() == EOF) return buffer;
-            while (charType(Stream::nxtChar()) == EMPTY) Stream::getChar();
-            if (charType(Stream::nxtChar()) == DIGIT) {
-                while (charType(Stream::nxtChar()) == DIGIT) 
-                    buffer += Stream::getChar();
-            } else if (charType(Stream::nxtChar()) == ALPHA) {
-                while (charType(Stream::nxtChar()) == DIGIT || charType(Stream::nxtChar()) == ALPHA)
-                    buffer += Stream::getChar();
-            } else {
-                switch (Stream::nxtChar()) {
-                    case '+': case '-': case '*': case '/': case '%':
-                    case '^': case ',': case ';': case '(': case ')':
-                    case '{': case '}': case '[': case ']': case '#':
-                        buffer += Stream::getChar();
-                        break;
-                    case '<':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '=' || Stream::nxtChar() == '<')
-                            buffer += Stream::getChar();
-                        break;
-                    case '>':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '=' || Stream::nxtChar() == '>')
-                            buffer += Stream::getChar();
-                        break;
-                    case '!':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '=')
-                            buffer += Stream::getChar();
-                        break;
-                    case '=':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '=')
-                            buffer += Stream::getChar();
-                        break;
-                    case '&':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '&')
-                            buffer += Stream::getChar();
-                        break;
-                    case '|':
-                        buffer += Stream::getChar();
-                        if (Stream::nxtChar() == '|')
-                            buffer += Stream::getChar();
-                        break;
+    // the call graph, its components and which functions are pure: clean
+    // ones that call only pure functions or those of their own component
+    void graph() {
+        std::vector<Tree*>& functions = Resolver::functions;
+        size_t n = functions.size();
+        calls.assign(n, std::vector<int>());
+        for (size_t f = 0; f < n; f++) callees(functions[f], calls[f]);
+        index.assign(n, 0);
+        low.assign(n, 0);
+        component.assign(n, 0);
+        on_path.assign(n, false);
+        recursive.assign(n, false);
+        order.clear();
+        visited = components = 0;
+        for (size_t f = 0; f < n; f++) {
+            if (index[f] == 0) connect(f);
+        }
+        functional.assign(n, false);
+        for (size_t i = 0, j; i < n; i = j) {
+            bool ok = true;
+            for (j = i; j < n && component[order[j]] == component[order[i]]; j++) {
+                int f = order[j];
+                // a body not parsed yet is not known to be clean
+                if (functions[f]->body != 0 || !clean(functions[f])) ok = false;
+                for (int g : calls[f]) {
+                    if (component[g] != component[f] && !functional[g]) ok = false;
                 }
             }
+            for (size_t k = i; k < j; k++) functional[order[k]] = ok;
         }
-        return buffer;
     }
 
-    inline std::string getLexeme() {
-        std::string ret = nxtLexeme();
-        buffer.clear();
-        return ret;
+    // copies the tree at from, moving every local it uses up by shift.
+    // the copy gets lists of its own, since the passes rewrite those
+    uint32_t copy(uint32_t from, int shift) {
+        if (from == 0) return 0;
+        Tree node = Ast::pools.nodes[from];
+        std::vector<uint32_t> kids(node.children.count);
+        for (size_t i = 0; i < kids.size(); i++) kids[i] = copy(Ast::pools.kids[node.children.first + i], shift);
+        node.children.first = Ast::pools.kids.size();
+        Ast::pools.kids.insert(Ast::pools.kids.end(), kids.begin(), kids.end());
+        std::vector<Object>& objects = Ast::pools.objects;
+        uint32_t first = objects.size();
+        for (size_t i = 0; i < node.vars.count; i++) {
+            Object obj = objects[node.vars.first + i];
+            if ((obj.type == VARIABLE || obj.type == ARRAY) && !obj.global) obj.slot += shift;
+            objects.push_back(obj);
+        }
+        node.vars.first = first;
+        Ast::pools.nodes.push_back(node);
+        return Ast::pools.nodes.size() - 1;
     }
-}
 
-struct Object {
-    obj_type type;
-    std::string name;
-    std::vector<int> dims;
-    int value;
-    std::vector<int> address;
-    Object(obj_type type):type(type), value(0) {
-        // std::cerr << "done1\n";
-        address.clear();
-        name.clear();
-        dims.clear();
-    }
-    Object(obj_type type, int val):type(type), value(val) {
-        // std::cerr << "done2\n";
-        address.clear();
-        name.clear();
-        dims.clear();
-    }
-    Object(obj_type type, const std::string& name):type(type), name(name), value(0) {
-        // std::cerr << "done3\n";
-        address.clear();
-        dims.clear();
+    // the call at site in function caller becomes an INLINE node: its
+    // arguments, then a copy of the callee's body. parameters and locals of
+    // the copy live in the caller's frame from shift on
+    void expand(uint32_t caller, uint32_t site, int shift) {
+        std::vector<Tree>& nodes = Ast::pools.nodes;
+        uint32_t def = defs[nodes[site].vars.front().slot];
+        nodes[caller].frame = std::max(nodes[caller].frame, shift + nodes[def].frame);
+        uint32_t body = copy(Ast::pools.kids[nodes[def].children.first], shift);
+        std::vector<Object>& objects = Ast::pools.objects;
+        uint32_t first = objects.size();
+        for (size_t i = 0; i < nodes[def].vars.count; i++) {
+            Object obj = objects[nodes[def].vars.first + i];
+            obj.slot += shift;
+            objects.push_back(obj);
+        }
+        Tree& cur = nodes[site];
+        std::vector<uint32_t>& kids = Ast::pools.kids;
+        std::vector<uint32_t> args(kids.begin() + cur.children.first, kids.begin() + cur.children.first + cur.children.count);
+        cur.type = INLINE;
+        cur.name = nodes[def].name;
+        cur.vars.first = first;
+        cur.vars.count = nodes[def].vars.count;
+        cur.children.first = kids.size();
+        cur.children.count = args.size() + 1;
+        kids.insert(kids.end(), args.begin(), args.end());
+        kids.push_back(body);
+        inlined++;
     }
 
-
-    void setArray(const std::vector<int>& def) {
-        assert(type == ARRAY);
-        int size = 1;
-        for (auto it = def.rbegin(); it != def.rend(); ++it) {
-            dims.push_back(size);
-            size *= *it;
+    // calls under cur that expand() may take, with where their part of the
+    // frame starts: at shift, and up to end. an expanded call sets its
+    // parameters while later arguments still run, so calls in its
+    // arguments go past its part. calls that never run at the same time
+    // share one part
+    void sites(const Tree* cur, const std::vector<bool>& small, int shift, int end,
+               std::vector<std::pair<uint32_t, int>>& out) {
+        if (cur == nullptr) return;
+        if (cur->type == UNIT0 && cur->vars.front().type == FUNCTION && cur->vars.front().slot >= 0) {
+            const Tree* def = Ast::at(defs[cur->vars.front().slot]);
+            if (small[cur->vars.front().slot] && cur->children.size() == def->vars.size()
+                && shift + def->frame <= end) {
+                out.emplace_back(id(cur), shift);
+                shift += def->frame;
+            }
         }
-        std::reverse(dims.begin(), dims.end());
-        address.resize(size);
+        for (auto chd : cur->children) sites(chd, small, shift, end, out);
     }
 
-    int& getArray(const std::vector<int> ind) {
-        assert(type == ARRAY);
-        int ret = 0;
-        for (size_t i = 0; i < ind.size(); i++) {
-            ret = ret + dims[i] * ind[i];
+    void Program(Tree* cur) {
+        std::vector<Tree*>& functions = Resolver::functions;
+        size_t n = functions.size();
+        graph();
+        if (limit == 0) {
+            for (auto def : functions) {
+                if (def->body != 0) continue;
+                Function(def);
+                if (tail) Tails(def);
+            }
+            return;
+        }
+        // expanding grows the pools, so nodes are held by index until the end
+        uint32_t root = id(cur);
+        defs.resize(n);
+        for (size_t f = 0; f < n; f++) defs[f] = id(functions[f]);
+        // a callee is expanded and optimized before any of its callers take
+        // a copy, so the size it is judged by is the size it ends up with
+        std::vector<bool> small(n, false);
+        for (int f : order) {
+            std::vector<std::pair<uint32_t, int>> found;
+            int base = Ast::at(defs[f])->frame;
+            long end = base + (recursive[f] ? RECURSIVE_GROWTH : GROWTH);
+            sites(Ast::at(defs[f]), small, base, int(std::min(end, long(Runner::STACK))), found);
+            for (auto& site : found) expand(defs[f], site.first, site.second);
+            Tree* def = Ast::at(defs[f]);
+            Function(def);
+            small[f] = !recursive[f] && !def->children.empty() && count(def->children.front()) <= limit;
+        }
+        for (size_t f = 0; f < n; f++) functions[f] = Ast::at(defs[f]);
+        if (tail) {
+            for (auto def : functions) Tails(def);
         }
-        return address[ret];
+        Root = Ast::at(root);
     }
-};
+}
 
-struct Tree {
-    stmt_type type;
-    std::string name;
-    std::vector<Tree*> children;
-    std::vector<Object> vars;
-    std::vector<std::string> ops;
-    Tree(stmt_type type):type(type) {
-        children.clear();
+// remembers what calls of pure recursive functions returned, so a naive
+// recursion runs each distinct argument tuple once. the cache is a table of
+// buckets of WAYS entries, each entry ints: function + 1 (0 when empty),
+// result, stamp, then the arguments. a full bucket gives up the entry with
+// the lowest stamp, which is when it was stored, or last hit with lru.
+// a function that hits less than once in 32 of its first PROBE lookups, a
+// recursion that never repeats itself, stops being cached.
+namespace Memo {
+    size_t cap = 2 << 20;   // --memo=MB: bytes of the table, 0 for none
+    bool lru = true;        // --memo-evict=lru|fifo
+    const int WAYS = 4;
+    const int ARGS = 8;     // functions with more parameters are not cached
+    const size_t PROBE = 1 << 12;
+
+    std::vector<bool> on;   // by function
+    std::vector<size_t> tried, found;  // by function, lookups and hits
+    std::vector<int> table;
+    size_t mask;            // buckets - 1
+    int stride;
+    unsigned stamp;
+    size_t lookups, hits;
+
+    void init() {
+        size_t n = Resolver::functions.size();
+        on.assign(n, false);
+        tried.assign(n, 0);
+        found.assign(n, 0);
+        int args = -1;
+        for (size_t f = 0; f < n && cap > 0 && f < Optimizer::functional.size(); f++) {
+            int params = Resolver::functions[f]->vars.size();
+            on[f] = Optimizer::functional[f] && Optimizer::recursive[f] && params <= ARGS;
+            if (on[f]) args = std::max(args, params);
+        }
+        if (args < 0) return;
+        stride = 3 + args;
+        size_t buckets = 1;
+        while (buckets * 2 * WAYS * stride * sizeof(int) <= cap) buckets *= 2;
+        mask = buckets - 1;
+        table.assign(buckets * WAYS * stride, 0);
     }
-};
 
-std::unordered_map<std::string, Tree*> func_table;
-Tree* Root;
+    // index of the function cur if its calls are cached, else -1
+    inline int index(const Tree* cur) {
+        if (table.empty()) return -1;
+        int f = Resolver::function_table[cur->name];
+        return on[f] ? f : -1;
+    }
 
+    inline int* bucket(int f, const int* args, int n) {
+        uint32_t h = f * 0x9e3779b9u;
+        for (int i = 0; i < n; i++) h = (h ^ uint32_t(args[i])) * 0x85ebca6bu;
+        h ^= h >> 15;
+        return table.data() + (h & mask) * WAYS * stride;
+    }
 
-namespace Parser {
+    inline bool match(const int* entry, int f, const int* args, int n) {
+        return entry[0] == f + 1 && std::equal(args, args + n, entry + 3);
+    }
 
-    Tree* Program();
-    Tree* Funcdef(const std::string&);
-    Tree* Vardef(const std::string&);
-    Tree* Statement();
-    Tree* Statements();
-    Tree* Expression();
-    Tree* Return();
-    Tree* If();
-    Tree* While();
-    Tree* For();
-    Tree* Unit0();
-    Tree* Unit1();
-    Tree* Unit2();
-    Tree* Unit3();
-    Tree* Unit4();
-    Tree* Unit5();
-    Tree* Unit6();
-    Tree* Unit7();
-    Tree* Unit8();
-    Tree* Unit9();
-
-    inline void match(const std::string& str) {
-        // std::cerr << "Match " + str << std::endl;
-        std::string tmp;
-        if ((tmp = Lexer::getLexeme()) != str)
-            throw "Match " + str + " Failed! " + tmp;
-    }
-
-    Tree* Program() {
-        Tree* ret = new Tree(PROGRAM);
-        match("#"), match("include"), match("<"), match("iostream"), match(">");
-        match("#"), match("include"), match("<"), match("cstdio"), match(">");
-        match("using"), match("namespace"), match("std"), match(";");
-        while (!Lexer::nxtLexeme().empty()) {
-            match("int");
-            std::string name = Lexer::getLexeme();
-            if (Lexer::nxtLexeme() == "(") {
-                ret->children.push_back(Funcdef(name));
-            } else {
-                ret->children.push_back(Vardef(name));
-                match(";");
-            }
+    inline bool find(int f, const int* args, int n, int& ret) {
+        lookups++;
+        if (++tried[f] == PROBE && found[f] < PROBE / 32) on[f] = false;
+        int* entry = bucket(f, args, n);
+        for (int w = 0; w < WAYS; w++, entry += stride) {
+            if (!match(entry, f, args, n)) continue;
+            hits++;
+            found[f]++;
+            if (lru) entry[2] = ++stamp;
+            ret = entry[1];
+            return true;
         }
-        func_table["putchar"] = nullptr;
-        return ret;
+        return false;
     }
 
-    Tree* Vardef(const std::string& name) {
-        Tree* ret = new Tree(VARDEF);
-        ret->vars.emplace_back(VARIABLE, name);
-        while (Lexer::nxtLexeme() != ";") {
-            if (Lexer::nxtLexeme() == "[") {
-                ret->vars.back().type = ARRAY;
-                while (Lexer::nxtLexeme() == "[") {
-                    match("[");
-                    ret->vars.back().dims.push_back(std::stoi(Lexer::getLexeme()));
-                    match("]");
-                }
-            } else {
-                match(",");
-                ret->vars.emplace_back(VARIABLE, Lexer::getLexeme());
+    inline void store(int f, const int* args, int n, int ret) {
+        int* entry = bucket(f, args, n);
+        int* victim = entry;
+        for (int w = 0; w < WAYS; w++, entry += stride) {
+            if (entry[0] == 0 || match(entry, f, args, n)) {
+                victim = entry;
+                break;
             }
+            if (unsigned(entry[2]) < unsigned(victim[2])) victim = entry;
         }
-        return ret;
+        victim[0] = f + 1;
+        victim[1] = ret;
+        victim[2] = ++stamp;
+        std::copy(args, args + n, victim + 3);
     }
+}
 
-    Tree* Funcdef(const std::string& name) {
-        Tree* ret = new Tree(FUNCDEF);
-        ret->name = name;
-        func_table[name] = ret;
-        match("(");
-        if (Lexer::nxtLexeme() != ")") {
-            match("int");
-            ret->vars.emplace_back(VARIABLE, Lexer::getLexeme());
-            while (Lexer::nxtLexeme() != ")") {
-                match(","), match("int");
-                ret->vars.emplace_back(VARIABLE, Lexer::getLexeme());
-            }
-        }
-        match(")");
-        ret->children.push_back(Statements());
-        return ret;
+// lowers the resolved Tree into a flat int code. every variable lives in one
+// int memory: globals at fixed offsets from 0, locals at fixed offsets from
+// the frame pointer of the running function. arrays are laid out inline.
+namespace Bytecode {
+    enum code_type {
+        OP_CONST,   // k          push k
+        OP_LOAD,    // off        push mem[fp + off]
+        OP_GLOAD,   // off        push mem[off]
+        OP_STORE,   // off        mem[fp + off] = top
+        OP_GSTORE,  // off        mem[off] = top
+        OP_ADDR,    // off        push fp + off
+        OP_GADDR,   // off        push off
+        OP_INDEX,   // stride     a, i -> a + i * stride
+        OP_LOADI,   //            a -> mem[a]
+        OP_STOREI,  //            a, v -> v, mem[a] = v
+        OP_ZERO,    // off, n     clear mem[fp + off .. fp + off + n)
+        OP_POP,
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+        OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+        OP_XOR, OP_SHL, OP_SHR, OP_NEG, OP_NOT,
+        OP_JMP,     // to
+        OP_JZ,      // to         pop, jump if zero
+        OP_JNZ,     // to         pop, jump if not zero
+        OP_CALL,    // f, argc    args -> result
+        OP_TAILCALL,// f, argc    args, then f runs in this frame and returns for it
+        OP_RET,     //            pop and return
+        OP_READ,    //            push Reader::read()
+        OP_PRINT,   //            pop and print
+        OP_ENDL,
+        OP_PUTCHAR  //            c -> 0
+    };
+
+    struct Proto {
+        std::string name;
+        int entry;
+        int params;
+        int frame;  // ints of locals
+        int depth;  // max operand stack depth
+    };
+
+    // where a store goes: a local or global offset, or an address on the stack
+    struct Place {
+        enum { LOCAL, GLOBAL, INDIRECT } kind;
+        int off;
+    };
+
+    std::vector<int> code;
+    std::vector<Proto> protos;
+    int global_size;
+
+    int depth, max_depth;
+    int self;  // the function being compiled
+
+    void Program(Tree*);
+    void Function(Tree*, Proto&);
+    void Statement(Tree*);
+    void Expression(Tree*);
+    Place Lvalue(Tree*);
+
+    inline void push(int delta) {
+        depth += delta;
+        max_depth = std::max(max_depth, depth);
     }
 
-    Tree* Statements() {
-        Tree* ret = new Tree(STATEMENTS);
-        match("{");
-        while (Lexer::nxtLexeme() != "}") {
-            std::string s = Lexer::nxtLexeme();
-            if (s == "int") {
-                match("int");
-                ret->children.push_back(Vardef(Lexer::getLexeme()));
-                match(";");
-            }
-            else if (s == "if") {
-                match("if");
-                ret->children.push_back(If());
-            }
-            else if (s == "for") {
-                match("for");
-                ret->children.push_back(For());
-            }
-            else if (s == "while") {
-                match("while");
-                ret->children.push_back(While());
-            }
-            else if (s == "return") {
-                match("return");
-                ret->children.push_back(Return());
-                match(";");
-            }
-            else if (s == "{") {
-                ret->children.push_back(Statements());
-            }
-            else {
-                ret->children.push_back(Expression());
-                match(";");
-            }
+    inline int emit(int op) {
+        code.push_back(op);
+        switch (op) {
+            case OP_CONST: case OP_LOAD: case OP_GLOAD:
+            case OP_ADDR: case OP_GADDR: case OP_READ:
+                push(1);
+                break;
+            case OP_INDEX: case OP_STOREI: case OP_POP:
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE:
+            case OP_XOR: case OP_SHL: case OP_SHR:
+            case OP_JZ: case OP_JNZ: case OP_RET: case OP_PRINT:
+                push(-1);
+                break;
         }
-        match("}");
-        return ret;
+        return code.size();
     }
 
-    Tree* Statement() {
-        Tree* ret = new Tree(STATEMENT);
-        std::string s = Lexer::nxtLexeme();
-        if (s == "int") {
-            match("int");
-            ret->children.push_back(Vardef(Lexer::getLexeme()));
-            match(";");
-        } else if (s == "if") {
-            match("if");
-            ret->children.push_back(If());
-        } else if (s == "for") {
-            match("for");
-            ret->children.push_back(For());
-        } else if (s == "while") {
-            match("while");
-            ret->children.push_back(While());
-        } else if (s == "return") {
-            match("return");
-            ret->children.push_back(Return());
-            match(";");
-        } else if (s == "{") {
-            ret->children.push_back(Statements());
-        } else {
-            ret->children.push_back(Expression());
-            match(";");
-        }
-        return ret;
+    inline int emit(int op, int arg) {
+        emit(op);
+        code.push_back(arg);
+        return code.size() - 1;
     }
 
-    Tree* If() {
-        Tree* ret = new Tree(IF);
-        match("(");
-        ret->children.push_back(Expression());
-        match(")");
-        ret->children.push_back(Statement());
-        if (Lexer::nxtLexeme() == "else") {
-            match("else");
-            ret->type = IF_ELSE;
-            ret->children.push_back(Statement());
-        }
-        return ret;
+    inline void patch(int at) {
+        code[at] = code.size();
     }
 
-    Tree* For() {
-        Tree* ret = new Tree(FOR);
-        match("(");
-        if (Lexer::nxtLexeme() != ";") {
-            if (Lexer::nxtLexeme() == "int") {
-                match("int");
-                ret->children.push_back(Vardef(Lexer::getLexeme()));
-            } else {
-                ret->children.push_back(Expression());
-            }
-        } else ret->children.push_back(nullptr);
-        match(";");
-        if (Lexer::nxtLexeme() != ";") {
-            ret->children.push_back(Expression());
-        } else ret->children.push_back(nullptr);
-        match(";");
-        if (Lexer::nxtLexeme() != ")") {
-            ret->children.push_back(Expression());
-        } else ret->children.push_back(nullptr);
-        match(")");
-        ret->children.push_back(Statement());
-        return ret;
+    // where a variable lives, which the Resolver has to have worked out
+    inline int slot(const Object& obj) {
+        if (obj.slot < 0) throw std::string("Undefined variable ") + Symbol::name(obj.name);
+        return obj.slot;
     }
 
-    Tree* While() {
-        Tree* ret = new Tree(WHILE);
-        match("(");
-        ret->children.push_back(Expression());
-        match(")");
-        ret->children.push_back(Statement());
-        return ret;
+    inline void declare(const Object& obj) {
+        code.push_back(OP_ZERO);
+        code.push_back(obj.slot);
+        code.push_back(Resolver::size(obj));
     }
 
-    Tree* Return() {
-        Tree* ret = new Tree(RETURN);
-        ret->children.push_back(Expression());
-        return ret;
+    // the UNIT0 below a chain of operator-free units, if there is one
+    inline Tree* leaf(Tree* cur) {
+        while (cur->type != UNIT0) {
+            if (cur->type == EXPR || cur->children.size() != 1 || !cur->ops.empty())
+                return nullptr;
+            cur = cur->children.front();
+        }
+        return cur;
     }
 
-    Tree* Expression() {
-        Tree* ret = new Tree(EXPR);
-        ret->children.push_back(Unit9());
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "<<" || s == ">>") {
-            if (s == "<<") match("<<");
-            else match(">>");
-            ret->ops.push_back(s);
-            ret->children.push_back(Unit9());
+    void Program(Tree*) {
+        global_size = Resolver::global_size;
+        // protos line up with Resolver::functions, so a call's slot is its proto
+        protos.resize(Resolver::functions.size());
+        for (size_t f = 0; f < protos.size(); ++f) {
+            protos[f].name = Symbol::name(Resolver::functions[f]->name);
+            self = f;
+            Function(Resolver::functions[f], protos[f]);
         }
-        return ret;
     }
 
-    Tree* Unit0() {
-        Tree* ret = new Tree(UNIT0);
-        std::string s = Lexer::nxtLexeme();
-        if (s == "cin") {
-            match("cin");
-            ret->vars.emplace_back(CIN);
-        } else if (s == "cout") {
-            match("cout");
-            ret->vars.emplace_back(COUT);
-        } else if (s == "endl") {
-            match("endl");
-            ret->vars.emplace_back(ENDL);
-        } else if (s == "(") {
-            ret->vars.emplace_back(VALUE);
-            match("(");
-            ret->children.push_back(Expression());
-            match(")");
-        } else if (isdigit(s[0])) { // vars[0].type = VALUE
-            ret->vars.emplace_back(VALUE, std::stoi(Lexer::getLexeme()));
-        } else {
-            s = Lexer::getLexeme();
-            if (Lexer::nxtLexeme() == "(") {
-                ret->vars.emplace_back(FUNCTION, s); // !children.empty() && vars
-                match("(");
-                if (Lexer::nxtLexeme() != ")") {
-                    ret->children.push_back(Expression());
-
-                    // std::cerr << Lexer::nxtLexeme() << "\n";
-                    while (Lexer::nxtLexeme() != ")") {
-                        match(",");
-                        ret->children.push_back(Expression());
+    void Function(Tree* cur, Proto& proto) {
+        proto.entry = code.size();
+        proto.params = cur->vars.size();
+        depth = max_depth = 0;
+        for (auto chd : cur->children) Statement(chd);
+        emit(OP_CONST, 0);
+        emit(OP_RET);
+        proto.frame = cur->frame;
+        proto.depth = max_depth;
+    }
+
+    void Statement(Tree* cur) {
+        int at, loop;
+        switch (cur->type) {
+            case VARDEF:
+                for (auto& obj : cur->vars) declare(obj);
+                break;
+            case STATEMENTS:
+            case STATEMENT:
+                for (auto chd : cur->children) Statement(chd);
+                break;
+            case IF:
+                Expression(cur->children[0]);
+                at = emit(OP_JZ, 0);
+                Statement(cur->children[1]);
+                patch(at);
+                break;
+            case IF_ELSE:
+                Expression(cur->children[0]);
+                at = emit(OP_JZ, 0);
+                Statement(cur->children[1]);
+                loop = emit(OP_JMP, 0);
+                patch(at);
+                Statement(cur->children[2]);
+                patch(loop);
+                break;
+            case WHILE:
+                loop = code.size();
+                Expression(cur->children[0]);
+                at = emit(OP_JZ, 0);
+                Statement(cur->children[1]);
+                emit(OP_JMP, loop);
+                patch(at);
+                break;
+            case FOR:
+                at = -1;
+                if (cur->children[0] != nullptr) {
+                    if (cur->children[0]->type == VARDEF) {
+                        Statement(cur->children[0]);
+                    } else {
+                        Expression(cur->children[0]);
+                        emit(OP_POP);
                     }
                 }
-                match(")");
-            } else {
-                ret->vars.emplace_back(VARIABLE, s);
+                loop = code.size();
+                if (cur->children[1] != nullptr) {
+                    Expression(cur->children[1]);
+                    at = emit(OP_JZ, 0);
+                }
+                Statement(cur->children[3]);
+                if (cur->children[2] != nullptr) {
+                    Expression(cur->children[2]);
+                    emit(OP_POP);
+                }
+                emit(OP_JMP, loop);
+                if (at >= 0) patch(at);
+                break;
+            case RETURN:
+                Expression(cur->children[0]);
+                emit(OP_RET);
+                break;
+            case TAILCALL: {
+                Tree* call = cur->children[0];
+                int f = call->vars.front().slot;
+                for (auto chd : call->children) Expression(chd);
+                if (f != self) {
+                    emit(OP_TAILCALL, f);
+                    code.push_back(call->children.size());
+                    push(-int(call->children.size()));
+                    break;
+                }
+                // a call of the function itself is a jump back to its start
+                const Range<Object>& params = Resolver::functions[f]->vars;
+                for (size_t i = params.size(); i-- > 0; ) {
+                    emit(OP_STORE, params[i].slot);
+                    emit(OP_POP);
+                }
+                emit(OP_JMP, protos[f].entry);
+                break;
             }
+            case EXPR: case UNIT0: case UNIT1: case UNIT2: case UNIT3: case UNIT4:
+            case UNIT5: case UNIT6: case UNIT7: case UNIT8: case UNIT9:
+                Expression(cur);
+                emit(OP_POP);
+                break;
+            default:
+                assert(0);
         }
-        if (Lexer::nxtLexeme() == "[") {
-            ret->vars.back().type = ARRAY;
-            while (Lexer::nxtLexeme() == "[") {
-                match("[");
-                ret->children.push_back(Expression());
-                match("]");
-            } 
-        }
-        return ret;
     }
 
-    Tree* Unit1() {
-        Tree* ret = new Tree(UNIT1);
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "+" || s == "-" || s == "!") {
-            if (s == "+") match("+");
-            else if (s == "-") match("-");
-            else match("!");
-            ret->ops.push_back(s);
-        }
-        ret->children.push_back(Unit0());
-        return ret;
+    inline void store(const Place& place) {
+        if (place.kind == Place::LOCAL) emit(OP_STORE, place.off);
+        else if (place.kind == Place::GLOBAL) emit(OP_GSTORE, place.off);
+        else emit(OP_STOREI);
     }
 
-    Tree* Unit2() {
-        Tree* ret = new Tree(UNIT2);
-        ret->children.push_back(Unit1());
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "*" || s == "/" || s == "%") {
-            if (s == "*") match("*");
-            else if (s == "/") match("/");
-            else match("%");
-            ret->ops.push_back(s);
-            ret->children.push_back(Unit1());
+    Place Lvalue(Tree* cur) {
+        Tree* u = leaf(cur);
+        if (u == nullptr || (u->vars.front().type != VARIABLE && u->vars.front().type != ARRAY))
+            throw std::string("Assignment to an rvalue");
+        const Object& obj = u->vars.front();
+        Place ret;
+        ret.off = slot(obj);
+        if (obj.type == VARIABLE) {
+            ret.kind = obj.global ? Place::GLOBAL : Place::LOCAL;
+        } else {
+            ret.kind = Place::INDIRECT;
+            emit(obj.global ? OP_GADDR : OP_ADDR, ret.off);
+            for (size_t i = 0; i < u->children.size(); i++) {
+                Expression(u->children[i]);
+                emit(OP_INDEX, i < obj.strides.size() ? obj.strides[i] : 0);
+            }
         }
         return ret;
     }
 
-    Tree* Unit3() {
-        Tree* ret = new Tree(UNIT3);
-        ret->children.push_back(Unit2());
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "+" || s == "-") {
-            if (s == "+") match("+");
-            else match("-");
-            ret->ops.push_back(s);
-            ret->children.push_back(Unit2());
+    void Expression(Tree* cur) {
+        int base = depth;
+        std::vector<int> ats;
+        std::vector<Place> places;
+        switch (cur->type) {
+            case EXPR: {
+                Tree* u = leaf(cur->children[0]);
+                obj_type head = u == nullptr ? VALUE : u->vars.front().type;
+                if (head == CIN) {
+                    for (size_t i = 1; i < cur->children.size(); i++) {
+                        Place place = Lvalue(cur->children[i]);
+                        emit(OP_READ);
+                        store(place);
+                        emit(OP_POP);
+                    }
+                    emit(OP_CONST, 0);
+                } else if (head == COUT) {
+                    for (size_t i = 1; i < cur->children.size(); i++) {
+                        u = leaf(cur->children[i]);
+                        if (u != nullptr && u->vars.front().type == ENDL) {
+                            emit(OP_ENDL);
+                        } else {
+                            Expression(cur->children[i]);
+                            emit(OP_PRINT);
+                        }
+                    }
+                    emit(OP_CONST, 0);
+                } else {
+                    Expression(cur->children[0]);
+                    for (size_t i = 0; i < cur->ops.size(); i++) {
+                        Expression(cur->children[i + 1]);
+                        emit(cur->ops[i] == SHIFT_LEFT ? OP_SHL : OP_SHR);
+                    }
+                }
+                break;
+            }
+            case UNIT9:
+                if (cur->ops.empty()) {
+                    Expression(cur->children[0]);
+                    break;
+                }
+                for (size_t i = 0; i + 1 < cur->children.size(); i++)
+                    places.push_back(Lvalue(cur->children[i]));
+                Expression(cur->children.back());
+                for (auto it = places.rbegin(); it != places.rend(); ++it)
+                    store(*it);
+                break;
+            case UNIT8:
+            case UNIT7:
+                Expression(cur->children[0]);
+                if (cur->ops.empty()) break;
+                for (size_t i = 0; i < cur->children.size(); i++) {
+                    if (i > 0) Expression(cur->children[i]);
+                    ats.push_back(emit(cur->type == UNIT8 ? OP_JNZ : OP_JZ, 0));
+                }
+                emit(OP_CONST, cur->type == UNIT8 ? 0 : 1);
+                ats.push_back(emit(OP_JMP, 0));
+                for (size_t i = 0; i + 1 < ats.size(); i++) patch(ats[i]);
+                depth = base;
+                emit(OP_CONST, cur->type == UNIT8 ? 1 : 0);
+                patch(ats.back());
+                break;
+            case UNIT6: case UNIT5: case UNIT4: case UNIT3: case UNIT2:
+                Expression(cur->children[0]);
+                for (size_t i = 0; i < cur->ops.size(); i++) {
+                    Expression(cur->children[i + 1]);
+                    switch (cur->ops[i]) {
+                        case XOR: emit(OP_XOR); break;
+                        case EQUAL: emit(OP_EQ); break;
+                        case NOT_EQUAL: emit(OP_NE); break;
+                        case LESS: emit(OP_LT); break;
+                        case LESS_EQUAL: emit(OP_LE); break;
+                        case GREATER: emit(OP_GT); break;
+                        case GREATER_EQUAL: emit(OP_GE); break;
+                        case PLUS: emit(OP_ADD); break;
+                        case MINUS: emit(OP_SUB); break;
+                        case TIMES: emit(OP_MUL); break;
+                        case DIVIDE: emit(OP_DIV); break;
+                        default: emit(OP_MOD);
+                    }
+                }
+                break;
+            case UNIT1:
+                Expression(cur->children[0]);
+                for (size_t i = cur->ops.size(); i-- > 0; ) {
+                    if (cur->ops[i] == MINUS) emit(OP_NEG);
+                    else if (cur->ops[i] == NOT) emit(OP_NOT);
+                }
+                break;
+            case UNIT0: {
+                const Object& obj = cur->vars.front();
+                if (obj.type == VALUE) {
+                    emit(OP_CONST, obj.value);
+                } else if (obj.type == FUNCTION) {
+                    for (auto chd : cur->children) Expression(chd);
+                    if (obj.slot < 0) {
+                        emit(OP_PUTCHAR);
+                    } else {
+                        emit(OP_CALL, obj.slot);
+                        code.push_back(cur->children.size());
+                        push(1 - cur->children.size());
+                    }
+                } else if (obj.type == VARIABLE) {
+                    emit(obj.global ? OP_GLOAD : OP_LOAD, slot(obj));
+                } else if (obj.type == ARRAY) {
+                    Lvalue(cur);
+                    emit(OP_LOADI);
+                } else {
+                    emit(OP_CONST, 0);
+                }
+                break;
+            }
+            default:
+                assert(0);
         }
-        return ret;
+    }
+}
+
+// runs Bytecode without recursing: an interpreted call pushes a Frame onto
+// a heap stack and jumps, a return pops it. the operand stack, the int
+// memory and the frames grow on demand until together they would pass
+// limit, so recursion depth is bounded by memory rather than by the native
+// stack.
+namespace VM {
+    using namespace Bytecode;
+
+    // where a caller resumes
+    struct Frame {
+        const int* pc;
+        int fp;
+        int f;
+    };
+
+    size_t limit = size_t(256) << 20;  // bytes, --stack-limit=MB
+
+    std::vector<int> mem;
+    std::vector<int> stack;
+    std::vector<Frame> frames;
+    int sp;
+
+    template <typename T>
+    inline void reserve(std::vector<T>& v, size_t size) {
+        if (v.size() < size) v.resize(std::max(v.size() * 2, size));
     }
 
-    Tree* Unit4() {
-        Tree* ret = new Tree(UNIT4);
-        ret->children.push_back(Unit3());
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "<" || s == "<=" || s == ">" || s == ">=") {
-            if (s == "<") match("<");
-            else if (s == ">") match(">");
-            else if (s == "<=") match("<=");
-            else match(">=");
-            ret->ops.push_back(s);
-            ret->children.push_back(Unit3());
-        }
-        return ret;
+    // makes room for function f running at fp
+    inline void enter(int f, int fp) {
+        size_t used = sizeof(int) * (size_t(fp) + protos[f].frame + sp + protos[f].depth)
+                    + sizeof(Frame) * frames.size();
+        if (used > limit) throw std::string("Stack overflow");
+        reserve(mem, fp + protos[f].frame);
+        reserve(stack, sp + protos[f].depth);
     }
 
-    Tree* Unit5() {
-        Tree* ret = new Tree(UNIT5);
-        ret->children.push_back(Unit4());
-        std::string s;
-        while ((s = Lexer::nxtLexeme()) == "==" || s == "!=") {
-            if (s == "==") match("==");
-            else match("!=");
-            ret->ops.push_back(s);
-            ret->children.push_back(Unit4());
+    int Run(int f, int fp) {
+        enter(f, fp);
+        const int* pc = code.data() + protos[f].entry;
+        int* m = mem.data();
+        int* s = stack.data();
+        int a, b;
+        for (;;) {
+            switch (*pc++) {
+                case OP_CONST: s[sp++] = *pc++; break;
+                case OP_LOAD: s[sp++] = m[fp + *pc++]; break;
+                case OP_GLOAD: s[sp++] = m[*pc++]; break;
+                case OP_STORE: m[fp + *pc++] = s[sp - 1]; break;
+                case OP_GSTORE: m[*pc++] = s[sp - 1]; break;
+                case OP_ADDR: s[sp++] = fp + *pc++; break;
+                case OP_GADDR: s[sp++] = *pc++; break;
+                case OP_INDEX: sp--; s[sp - 1] += s[sp] * *pc++; break;
+                case OP_LOADI: s[sp - 1] = m[s[sp - 1]]; break;
+                case OP_STOREI: sp--; m[s[sp - 1]] = s[sp]; s[sp - 1] = s[sp]; break;
+                case OP_ZERO: std::fill(m + fp + pc[0], m + fp + pc[0] + pc[1], 0); pc += 2; break;
+                case OP_POP: sp--; break;
+                case OP_ADD: sp--; s[sp - 1] += s[sp]; break;
+                case OP_SUB: sp--; s[sp - 1] -= s[sp]; break;
+                case OP_MUL: sp--; s[sp - 1] *= s[sp]; break;
+                case OP_DIV: sp--; s[sp - 1] /= s[sp]; break;
+                case OP_MOD: sp--; s[sp - 1] %= s[sp]; break;
+                case OP_LT: sp--; s[sp - 1] = s[sp - 1] < s[sp]; break;
+                case OP_LE: sp--; s[sp - 1] = s[sp - 1] <= s[sp]; break;
+                case OP_GT: sp--; s[sp - 1] = s[sp - 1] > s[sp]; break;
+                case OP_GE: sp--; s[sp - 1] = s[sp - 1] >= s[sp]; break;
+                case OP_EQ: sp--; s[sp - 1] = s[sp - 1] == s[sp]; break;
+                case OP_NE: sp--; s[sp - 1] = s[sp - 1] != s[sp]; break;
+                case OP_XOR: sp--; s[sp - 1] ^= s[sp]; break;
+                case OP_SHL: sp--; s[sp - 1] <<= s[sp]; break;
+                case OP_SHR: sp--; s[sp - 1] >>= s[sp]; break;
+                case OP_NEG: s[sp - 1] = -s[sp - 1]; break;
+                case OP_NOT: s[sp - 1] = !s[sp - 1]; break;
+                case OP_JMP: pc = code.data() + *pc; break;
+                case OP_JZ: if (s[--sp] == 0) pc = code.data() + *pc; else pc++; break;
+                case OP_JNZ: if (s[--sp] != 0) pc = code.data() + *pc; else pc++; break;
+                case OP_CALL:
+                    a = pc[0], b = pc[1];
+                    sp -= b;
+                    frames.push_back(Frame{pc + 2, fp, f});
+                    fp += protos[f].frame;
+                    f = a;
+                    enter(f, fp);
+                    m = mem.data();
+                    s = stack.data();
+                    for (int i = 0; i < b; i++) m[fp + i] = s[sp + i];
+                    pc = code.data() + protos[f].entry;
+                    break;
+                case OP_TAILCALL:
+                    // f takes over the frame, and its OP_RET is ours
+                    a = pc[0], b = pc[1];
+                    sp -= b;
+                    f = a;
+                    enter(f, fp);
+                    m = mem.data();
+                    s = stack.data();
+                    for (int i = 0; i < b; i++) m[fp + i] = s[sp + i];
+                    pc = code.data() + protos[f].entry;
+                    break;
+                case OP_RET:
+                    // the result is already where the caller wants it
+                    if (frames.empty()) return s[--sp];
+                    pc = frames.back().pc, fp = frames.back().fp, f = frames.back().f;
+                    frames.pop_back();
+                    break;
+                case OP_READ: s[sp++] = Reader::read(); break;
+                case OP_PRINT: Output::number(s[--sp]); break;
+                case OP_ENDL: Output::endl(); break;
+                case OP_PUTCHAR: Output::put(char(s[sp - 1])); s[sp - 1] = 0; break;
+                default: assert(0);
+            }
         }
-        return ret;
     }
 
-    Tree* Unit6() {
-        Tree* ret = new Tree(UNIT6);
-        ret->children.push_back(Unit5());
-        while (Lexer::nxtLexeme() == "^") {
-            match("^");
-            ret->ops.push_back("^");
-            ret->children.push_back(Unit5());
-        }
-        return ret;
+    void Main() {
+        Bytecode::Program(Root);
+        int entry = Resolver::function("main");
+        if (entry < 0) throw std::string("Undefined function main");
+        mem.assign(global_size, 0);
+        sp = 0;
+        Run(entry, global_size);
     }
+}
 
-    Tree* Unit7() {
-        Tree* ret = new Tree(UNIT7);
-        ret->children.push_back(Unit6());
-        while (Lexer::nxtLexeme() == "&&") {
-            match("&&");
-            ret->ops.push_back("&&");
-            ret->children.push_back(Unit6());
-        }
-        return ret;
+namespace Runner {
+    extern std::vector<int> globals;
+    int Function(Tree*, const int*);
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+// compiles the Bytecode of hot functions to x86-64. the operand stack is the
+// native stack (one 8-byte slot per value, pointers for array addresses),
+// locals sit below rbp, globals are the tree walker's own Objects.
+// a compiled function is int f(const long* args) where args points at the
+// last of the arguments pushed in order, i.e. argument i is args[n - 1 - i].
+namespace Jit {
+    using namespace Bytecode;
+    typedef int (*native_fn)(const long*);
+
+    bool enabled;
+    int threshold = 1;
+    std::unordered_map<Tree*, int> index;
+    std::vector<Tree*> trees;
+    std::vector<native_fn> native;
+    std::vector<int> calls;
+
+    std::vector<unsigned char> buf;
+
+    inline void byte(int x) { buf.push_back(x); }
+    inline void bytes(std::initializer_list<int> xs) { for (int x : xs) buf.push_back(x); }
+    inline void dword(int x) { for (int i = 0; i < 4; i++) buf.push_back((unsigned(x) >> (8 * i)) & 0xff); }
+    // the walker's global memory never moves once Runner::Main sized it
+    inline const void* global(int off) {
+        return Runner::globals.data() + off;
+    }
+
+    inline void qword(const void* p) {
+        unsigned long x = (unsigned long)p;
+        for (int i = 0; i < 8; i++) buf.push_back((x >> (8 * i)) & 0xff);
     }
 
-    Tree* Unit8() {
-        Tree* ret = new Tree(UNIT8);
-        ret->children.push_back(Unit7());
-        while (Lexer::nxtLexeme() == "||") {
-            match("||");
-            ret->ops.push_back("||");
-            ret->children.push_back(Unit7());
+    // call a C++ helper with rsp realigned to 16 bytes, rbx keeps the old one
+    inline void helper(const void* fn) {
+        bytes({0x48, 0xb8}), qword(fn);          // mov rax, fn
+        bytes({0x48, 0x89, 0xe3});               // mov rbx, rsp
+        bytes({0x48, 0x83, 0xe4, 0xf0});         // and rsp, -16
+        bytes({0xff, 0xd0});                     // call rax
+        bytes({0x48, 0x89, 0xdc});               // mov rsp, rbx
+    }
+
+    int read() { return Reader::read(); }
+    void print(int x) { Output::number(x); }
+    void endl() { Output::endl(); }
+    int put(int c) { Output::put(char(c)); return 0; }
+    int call(int, const long*);
+
+    void compile(int f) {
+        const Proto& proto = protos[f];
+        int locals = (4 * proto.frame + 7) & ~7;
+        auto local = [&](int off) { return -8 - locals + 4 * off; };
+        std::unordered_map<int, int> target;     // bytecode pc -> native offset
+        std::vector<std::pair<int, int> > jumps; // rel32 position, bytecode pc
+        buf.clear();
+        bytes({0x55, 0x48, 0x89, 0xe5, 0x53});   // push rbp; mov rbp, rsp; push rbx
+        bytes({0x48, 0x81, 0xec}), dword(locals); // sub rsp, locals
+        for (int i = 0; i < proto.params; i++) {
+            bytes({0x8b, 0x87}), dword(8 * (proto.params - 1 - i)); // mov eax, [rdi + d]
+            bytes({0x89, 0x85}), dword(local(i));                   // mov [rbp + d], eax
         }
-        return ret;
+        const int* pc = code.data() + proto.entry;
+        const int* end = code.data() + (f + 1 < int(protos.size()) ? protos[f + 1].entry : code.size());
+        auto jump = [&](std::initializer_list<int> op, int to) {
+            bytes(op);
+            jumps.emplace_back(buf.size(), to);
+            dword(0);
+        };
+        while (pc < end) {
+            target[pc - code.data()] = buf.size();
+            int op = *pc++;
+            switch (op) {
+                case OP_CONST: byte(0x68), dword(*pc++); break;                  // push k
+                case OP_LOAD:
+                    bytes({0x48, 0x63, 0x85}), dword(local(*pc++));              // movsxd rax, [rbp + d]
+                    byte(0x50);
+                    break;
+                case OP_GLOAD:
+                    bytes({0x48, 0xb8}), qword(global(*pc++));
+                    bytes({0x48, 0x63, 0x00, 0x50});                             // movsxd rax, [rax]; push rax
+                    break;
+                case OP_STORE:
+                    bytes({0x8b, 0x04, 0x24});                                   // mov eax, [rsp]
+                    bytes({0x89, 0x85}), dword(local(*pc++));
+                    break;
+                case OP_GSTORE:
+                    bytes({0x48, 0xb9}), qword(global(*pc++));           // mov rcx, addr
+                    bytes({0x8b, 0x04, 0x24, 0x89, 0x01});                       // mov eax, [rsp]; mov [rcx], eax
+                    break;
+                case OP_ADDR:
+                    bytes({0x48, 0x8d, 0x85}), dword(local(*pc++));              // lea rax, [rbp + d]
+                    byte(0x50);
+                    break;
+                case OP_GADDR:
+                    bytes({0x48, 0xb8}), qword(global(*pc++));
+                    byte(0x50);
+                    break;
+                case OP_INDEX:
+                    bytes({0x59, 0x48, 0x63, 0xc9});                             // pop rcx; movsxd rcx, ecx
+                    bytes({0x48, 0x69, 0xc9}), dword(4 * *pc++);                 // imul rcx, rcx, 4 * stride
+                    bytes({0x48, 0x01, 0x0c, 0x24});                             // add [rsp], rcx
+                    break;
+                case OP_LOADI: bytes({0x58, 0x48, 0x63, 0x00, 0x50}); break;     // pop rax; movsxd rax, [rax]; push rax
+                case OP_STOREI: bytes({0x59, 0x58, 0x89, 0x08, 0x51}); break;    // pop rcx; pop rax; mov [rax], ecx; push rcx
+                case OP_ZERO:
+                    bytes({0x48, 0x8d, 0xbd}), dword(local(pc[0]));              // lea rdi, [rbp + d]
+                    byte(0xb9), dword(pc[1]);                                    // mov ecx, n
+                    bytes({0x31, 0xc0, 0xf3, 0xab});                             // xor eax, eax; rep stosd
+                    pc += 2;
+                    break;
+                case OP_POP: byte(0x59); break;
+                case OP_ADD: bytes({0x59, 0x58, 0x01, 0xc8, 0x50}); break;
+                case OP_SUB: bytes({0x59, 0x58, 0x29, 0xc8, 0x50}); break;
+                case OP_MUL: bytes({0x59, 0x58, 0x0f, 0xaf, 0xc1, 0x50}); break;
+                case OP_DIV: bytes({0x59, 0x58, 0x99, 0xf7, 0xf9, 0x50}); break; // cdq; idiv ecx
+                case OP_MOD: bytes({0x59, 0x58, 0x99, 0xf7, 0xf9, 0x52}); break;
+                case OP_XOR: bytes({0x59, 0x58, 0x31, 0xc8, 0x50}); break;
+                case OP_SHL: bytes({0x59, 0x58, 0xd3, 0xe0, 0x50}); break;
+                case OP_SHR: bytes({0x59, 0x58, 0xd3, 0xf8, 0x50}); break;
+                case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE: {
+                    int cc = op == OP_LT ? 0x9c : op == OP_LE ? 0x9e : op == OP_GT ? 0x9f :
+                             op == OP_GE ? 0x9d : op == OP_EQ ? 0x94 : 0x95;
+                    bytes({0x59, 0x58, 0x39, 0xc8});                             // cmp eax, ecx
+                    bytes({0x0f, cc, 0xc0, 0x0f, 0xb6, 0xc0, 0x50});             // setcc al; movzx eax, al
+                    break;
+                }
+                case OP_NEG: bytes({0xf7, 0x1c, 0x24}); break;                   // neg dword [rsp]
+                case OP_NOT: bytes({0x58, 0x85, 0xc0, 0x0f, 0x94, 0xc0, 0x0f, 0xb6, 0xc0, 0x50}); break;
+                case OP_JMP: jump({0xe9}, *pc++); break;
+                case OP_JZ: bytes({0x58, 0x85, 0xc0}), jump({0x0f, 0x84}, *pc++); break;
+                case OP_JNZ: bytes({0x58, 0x85, 0xc0}), jump({0x0f, 0x85}, *pc++); break;
+                case OP_CALL:
+                case OP_TAILCALL: {
+                    // a tail call is compiled as a call and a return
+                    int g = pc[0], argc = pc[1];
+                    pc += 2;
+                    // compiled callees are called directly through their slot
+                    bytes({0x48, 0xb8}), qword(&native[g]);
+                    bytes({0x48, 0x8b, 0x00, 0x48, 0x85, 0xc0});                 // mov rax, [rax]; test rax, rax
+                    bytes({0x74, 0x00});                                         // jz slow
+                    int slow = buf.size();
+                    bytes({0x48, 0x89, 0xe7, 0xff, 0xd0});                       // mov rdi, rsp; call rax
+                    bytes({0xeb, 0x00});                                         // jmp done
+                    int done = buf.size();
+                    buf[slow - 1] = done - slow;
+                    byte(0xbf), dword(g);                                        // slow: mov edi, g
+                    bytes({0x48, 0x89, 0xe6});                                   // mov rsi, rsp
+                    helper((void*)call);
+                    buf[done - 1] = buf.size() - done;
+                    bytes({0x48, 0x81, 0xc4}), dword(8 * argc);                  // done: add rsp, 8 * argc
+                    byte(0x50);
+                    if (op == OP_TAILCALL) bytes({0x58, 0x48, 0x8b, 0x5d, 0xf8, 0xc9, 0xc3});
+                    break;
+                }
+                case OP_RET: bytes({0x58, 0x48, 0x8b, 0x5d, 0xf8, 0xc9, 0xc3}); break; // pop rax; mov rbx, [rbp - 8]; leave; ret
+                case OP_READ: helper((void*)read), byte(0x50); break;
+                case OP_PRINT: byte(0x5f), helper((void*)print); break;
+                case OP_ENDL: helper((void*)endl); break;
+                case OP_PUTCHAR: byte(0x5f), helper((void*)put), byte(0x50); break;
+                default: assert(0);
+            }
+        }
+        for (auto& j : jumps) {
+            int rel = target[j.second] - (j.first + 4);
+            for (int i = 0; i < 4; i++) buf[j.first + i] = (unsigned(rel) >> (8 * i)) & 0xff;
+        }
+        size_t size = (buf.size() + 4095) & ~size_t(4095);
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) throw std::string("JIT: mmap failed");
+        memcpy(mem, buf.data(), buf.size());
+        if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) throw std::string("JIT: mprotect failed");
+        native[f] = (native_fn)mem;
     }
-    Tree* Unit9() {
-        Tree* ret = new Tree(UNIT9);
-        ret->children.push_back(Unit8());
-        while (Lexer::nxtLexeme() == "=") {
-            match("=");
-            ret->ops.push_back("=");
-            ret->children.push_back(Unit8());
+
+    // after the tree walker has declared its globals
+    void Init() {
+        Bytecode::Program(Root);
+        native.assign(protos.size(), nullptr);
+        calls.assign(protos.size(), 0);
+        trees.assign(protos.size(), nullptr);
+        for (size_t f = 0; f < protos.size(); ++f) {
+            index[Resolver::functions[f]] = f;
+            trees[f] = Resolver::functions[f];
         }
-        return ret;
+    }
+
+    int call(int f, const long* args) {
+        if (native[f] != nullptr) return native[f](args);
+        std::vector<int> params(protos[f].params);
+        for (size_t i = 0; i < params.size(); i++) params[i] = args[params.size() - 1 - i];
+        return Runner::Function(trees[f], params.data());
+    }
+
+    bool Function(Tree* cur, const int* params, int& ret) {
+        int f = index[cur];
+        if (native[f] == nullptr && ++calls[f] >= threshold) compile(f);
+        if (native[f] == nullptr) return false;
+        std::vector<long> args(params, params + protos[f].params);
+        std::reverse(args.begin(), args.end());
+        ret = native[f](args.data());
+        return true;
     }
 }
+#else
+namespace Jit {
+    bool enabled;
+    int threshold = 1;
+    void Init() {
+        throw std::string("JIT: only x86-64 Linux is supported");
+    }
+    bool Function(Tree*, const int*, int&) {
+        return false;
+    }
+}
+#endif
+
+// what the runner passes around for an evaluated unit: a plain int, or the
+// int cell it denotes when it can be assigned to. cin, cout and endl only
+// carry their type.
+struct Value {
+    obj_type type;  // VALUE, VARIABLE (ref is set), CIN, COUT or ENDL
+    int value;
+    int* ref;
+};
 
 namespace Runner {
     int Program(Tree*);
     int Statement(Tree*);
     int Statements(Tree*);
     int Return(Tree*);
+    int TailCall(Tree*);
     int If(Tree*);
     int While(Tree*);
     int For(Tree*);
-    int Function(Tree*, const std::vector<int>&);
+    int Function(Tree*, const int*);
     int Expression(Tree*);
-    Object Unit0(Tree*);
-    Object Unit1(Tree*);
-    Object Unit2(Tree*);
-    Object Unit3(Tree*);
-    Object Unit4(Tree*);
-    Object Unit5(Tree*);
-    Object Unit6(Tree*);
-    Object Unit7(Tree*);
-    Object Unit8(Tree*);
-    Object Unit9(Tree*);
-
-    std::unordered_map<std::string, std::vector<Object> > var_table;
+    Value Unit(Tree*);
+    Value Unit0(Tree*);
+    Value Unit1(Tree*);
+    Value Unit2(Tree*);
+    Value Unit3(Tree*);
+    Value Unit4(Tree*);
+    Value Unit5(Tree*);
+    Value Unit6(Tree*);
+    Value Unit7(Tree*);
+    Value Unit8(Tree*);
+    Value Unit9(Tree*);
+    int Inline(Tree*);
+
+    // every frame is a bump of one int stack of STACK ints. the stack is
+    // reserved once and never moves, so a Value may keep pointing into it
+    // across calls
+
+    std::vector<int> globals;
+    int* stack;
+    int* top;     // first int past the running frame
+    int* locals;  // frame of the running function
 
     bool return_tag;
-    std::string func_tag;
+    Tree* tail;  // set by a TAILCALL for the Function it returns from
 
-    int Function(Tree* cur, const std::vector<int>& params) {
+    int Function(Tree* cur, const int* params) {
         // std::cerr << "in func " + cur->name << "\n";
         // for (auto x : params) 
             // std::cerr << x << " ";
         // std::cerr << "\n";
         if (cur == nullptr) {
-            putchar(char(params.front()));
+            Output::put(char(params[0]));
             return 0;
         }
-        func_tag = cur->name;
-        assert(params.size() == cur->vars.size());
-        for (size_t i = 0; i < params.size(); i++) {
-            var_table[cur->vars[i].name].emplace_back(VARIABLE, params[i]);
+        if (cur->body != 0) {
+            Parser::Body(cur);
+            Resolver::Function(cur);
+            if (Optimizer::fold || Optimizer::dce) Optimizer::Function(cur);
+            if (Optimizer::tail) Optimizer::Tails(cur);
         }
-        int ret = 0;
-        if (!cur->children.empty()) {
-            ret = Statements(cur->children.front());
+        int memo = Memo::index(cur);
+        int key[Memo::ARGS];
+        int n = cur->vars.size();
+        if (memo >= 0) {
+            int ret;
+            if (Memo::find(memo, params, n, ret)) return ret;
+            std::copy(params, params + n, key);
         }
-        for (size_t i = 0; i < params.size(); i++) {
-            var_table[cur->vars[i].name].pop_back();
+        int native;
+        if (Jit::enabled && Jit::Function(cur, params, native)) return native;
+        // params may already sit where the frame starts, see Unit0
+        int* frame = top;
+        if (frame + cur->frame > stack + STACK) throw std::string("Stack overflow");
+        for (size_t i = 0; i < cur->vars.size(); i++) {
+            frame[i] = params[i];
         }
+        int* saved = locals;
+        locals = frame;
+        top = frame + cur->frame;
+        int ret = 0;
+        for (;;) {
+            if (!cur->children.empty()) {
+                ret = Statements(cur->children.front());
+            }
+            if (tail == nullptr) break;
+            // a TAILCALL left the arguments at top: the callee takes over
+            // the frame, and for a call of cur itself that is a jump back
+            int* args = top;
+            if (tail != cur && frame + tail->frame > stack + STACK) throw std::string("Stack overflow");
+            cur = tail;
+            tail = nullptr;
+            return_tag = false;
+            std::copy(args, args + cur->vars.size(), frame);
+            top = frame + cur->frame;
+        }
+        top = frame;
+        locals = saved;
         return_tag = false;
+        if (memo >= 0) Memo::store(memo, key, n, ret);
         return ret;
     }
 
-    
+    inline int* cell(const Object& obj) {
+        return (obj.global ? globals.data() : locals) + obj.slot;
+    }
+
+    // a declaration executes as a fresh zeroed variable
+    inline void declare(const Object& obj) {
+        if (obj.type != ARRAY) *cell(obj) = 0;
+        else std::fill_n(cell(obj), Resolver::size(obj), 0);
+    }
+
 
     int Statements(Tree* cur) {
         // std::cerr << "in stmts\n";
-        std::vector<std::string> new_vars;
         int ret = 0;
         for (auto chd : cur->children) {
             int tmp = 0;
             switch (chd->type) {
                 case VARDEF:
-                    for (auto obj : chd->vars) {
-                        new_vars.push_back(obj.name);
-                        // auto &v = var_table[obj.name];
-                        // std::cerr << v.size() << " 234\n";
-                        // v.push_back(Object(VALUE, 1));
-                        // std::cerr << v.size() << " 345\n";
-                        // v.pop_back();
-                        var_table[obj.name].emplace_back(obj.type);
-                        // std::cerr << var_table[obj.name].size() << "\n";
-                        if (obj.type == ARRAY) {
-                            auto &u = var_table[obj.name].back();
-                            u.setArray(obj.dims);
-                        }
-                    }
+                    for (auto& obj : chd->vars) declare(obj);
                     break;
                 case IF:
                 case IF_ELSE:
@@ -678,10 +2944,15 @@ namespace Runner {
                     tmp = Return(chd);
                     return_tag = true;
                     break;
+                case TAILCALL:
+                    tmp = TailCall(chd);
+                    return_tag = true;
+                    break;
                 case STATEMENTS:
                     tmp = Statements(chd);
                     break;
-                case EXPR:
+                case EXPR: case UNIT0: case UNIT1: case UNIT2: case UNIT3: case UNIT4:
+                case UNIT5: case UNIT6: case UNIT7: case UNIT8: case UNIT9: case INLINE:
                     Expression(chd);
                     break;
                 default:
@@ -693,30 +2964,20 @@ namespace Runner {
                 break;
             }
         }
-        for (auto name : new_vars) {
-            var_table[name].pop_back();
-        }
         return ret;
     }
 
     int Statement(Tree* cur) {
         // std::cerr << "in stmt\n";
-        std::vector<std::string> new_vars;
         int ret = 0;
         for (auto chd : cur->children) {
             int tmp = 0;
             switch (chd->type) {
                 case VARDEF:
-                    for (auto obj : chd->vars) {
-                        new_vars.push_back(obj.name);
-                        var_table[obj.name].emplace_back(obj.type);
-                        if (obj.type == ARRAY) {
-                            auto& u = var_table[obj.name].back();
-                            u.setArray(obj.dims);
-                        }
-                    }
+                    for (auto& obj : chd->vars) declare(obj);
                     break;
                 case IF:
+                case IF_ELSE:
                     tmp = If(chd);
                     break;
                 case FOR:
@@ -729,10 +2990,15 @@ namespace Runner {
                     tmp = Return(chd);
                     return_tag = true;
                     break;
+                case TAILCALL:
+                    tmp = TailCall(chd);
+                    return_tag = true;
+                    break;
                 case STATEMENTS:
                     tmp = Statements(chd);
                     break;
-                case EXPR:
+                case EXPR: case UNIT0: case UNIT1: case UNIT2: case UNIT3: case UNIT4:
+                case UNIT5: case UNIT6: case UNIT7: case UNIT8: case UNIT9: case INLINE:
                     Expression(chd);
                     break;
                 default:
@@ -743,9 +3009,6 @@ namespace Runner {
                 break;
             }
         }
-        for (auto name : new_vars) {
-            var_table[name].pop_back();
-        }
         return ret;
     }
 
@@ -764,17 +3027,9 @@ namespace Runner {
     int For(Tree* cur) {
         // std::cerr << "in for\n";
         int ret = 0;
-        std::vector<std::string> new_vars;
         if (cur->children[0] != nullptr) {
             if (cur->children[0]->type == VARDEF) {
-                for (auto obj : cur->children[0]->vars) {
-                    new_vars.push_back(obj.name);
-                    var_table[obj.name].emplace_back(obj.type);
-                    if (obj.type == ARRAY) {
-                        auto& u = var_table[obj.name].back();
-                        u.setArray(obj.dims);
-                    }
-                }
+                for (auto& obj : cur->children[0]->vars) declare(obj);
             } else {
                 Expression(cur->children[0]);
             }
@@ -789,9 +3044,6 @@ namespace Runner {
                 Expression(cur->children[2]);
             }
         }
-        for (auto name : new_vars) {
-            var_table[name].pop_back();
-        }
         return ret;
     }
 
@@ -816,248 +3068,500 @@ namespace Runner {
         return ret;
     }
 
+    // pushes the arguments and leaves the call to Function, unless the
+    // callee has to go through Function's front door to be parsed or
+    // compiled. the cache is not asked: the call that started the chain
+    // stores what the chain ends with
+    int TailCall(Tree* cur) {
+        Tree* call = cur->children[0];
+        Tree* callee = Resolver::functions[call->vars.front().slot];
+        if (callee->body != 0 || Jit::enabled) return Return(cur);
+        int* base = top;
+        if (base + call->children.size() > stack + STACK) throw std::string("Stack overflow");
+        for (auto chd : call->children) {
+            int x = Expression(chd);
+            *top++ = x;
+        }
+        top = base;
+        tail = callee;
+        return_tag = true;
+        return 0;
+    }
+
+
+    inline Value value(int x) {
+        Value ret;
+        ret.type = VALUE;
+        ret.value = x;
+        ret.ref = nullptr;
+        return ret;
+    }
 
-    inline int getVal(const Object& obj) {
-        assert(obj.type == VARIABLE || obj.type == ARRAY || obj.type == VALUE);
-        if (obj.type == VALUE) return obj.value;
-        else if (obj.type == VARIABLE) return var_table[obj.name].back().value;
-        else return var_table[obj.name].back().getArray(obj.dims);
+    inline int getVal(const Value& val) {
+        assert(val.type == VARIABLE || val.type == VALUE);
+        return val.ref != nullptr ? *val.ref : val.value;
     }
 
-    inline int& getVar(const Object& obj) {
-        assert(obj.type == VARIABLE || obj.type == ARRAY);
-        if (obj.type == VARIABLE) return var_table[obj.name].back().value;
-        else return var_table[obj.name].back().getArray(obj.dims);
+    inline int& getVar(const Value& val) {
+        assert(val.type == VARIABLE);
+        return *val.ref;
     }
 
 
     int Expression(Tree* cur) {
         // std::cerr << "in Expr\n";
-        Object obj = Unit9(cur->children[0]);
+        if (cur->type != EXPR) return getVal(Unit(cur));
+        Value obj = Unit(cur->children[0]);
         // std::cerr << "expr done\n";
         if (obj.type == CIN) {
             for (size_t i = 1; i < cur->children.size(); i++) {
-                getVar(Unit9(cur->children[i])) = Reader::read();
+                getVar(Unit(cur->children[i])) = Reader::read();
             }
             return 0;
         } else if (obj.type == COUT) {
             for (size_t i = 1; i < cur->children.size(); i++) {
-                Object u = Unit9(cur->children[i]);
+                Value u = Unit(cur->children[i]);
                 if (u.type == ENDL) {
-                    std::cout << std::endl;
+                    Output::endl();
                 } else {
-                    std::cout << getVal(u);
+                    Output::number(getVal(u));
                 }
             }
             return 0;
         } else {
             int ret = getVal(obj);
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                int tmp = getVal(Unit9(cur->children[i + 1]));
-                if (cur->ops[i] == "<<") ret = ret << tmp;
+                int tmp = getVal(Unit(cur->children[i + 1]));
+                if (cur->ops[i] == SHIFT_LEFT) ret = ret << tmp;
                 else ret = ret >> tmp; 
             }
             return ret;
         }
     }
 
-    Object Unit0(Tree* cur) {
+    Value Unit(Tree* cur) {
+        switch (cur->type) {
+            case UNIT0: return Unit0(cur);
+            case UNIT1: return Unit1(cur);
+            case UNIT2: return Unit2(cur);
+            case UNIT3: return Unit3(cur);
+            case UNIT4: return Unit4(cur);
+            case UNIT5: return Unit5(cur);
+            case UNIT6: return Unit6(cur);
+            case UNIT7: return Unit7(cur);
+            case UNIT8: return Unit8(cur);
+            case UNIT9: return Unit9(cur);
+            case INLINE: return value(Inline(cur));
+            default: return value(Expression(cur));
+        }
+    }
+
+    Value Unit0(Tree* cur) {
         // std::cerr << "in 0\n";
-        Object ret = cur->vars.front();
-        if (ret.type == CIN || ret.type == COUT || ret.type == ENDL) {
-            return ret;
-        } else if (ret.type == VALUE) {
-            if (!cur->children.empty())
-                ret.value = Expression(cur->children[0]);
-            return ret;
-        } else if (ret.type == FUNCTION) {
-            std::vector<int> params;
-            for (auto chd : cur->children)
-                params.push_back(Expression(chd));
+        const Object& obj = cur->vars.front();
+        Value ret;
+        ret.type = obj.type;
+        ret.value = obj.value;
+        ret.ref = nullptr;
+        if (obj.type == FUNCTION) {
+            // arguments are pushed right where the callee's frame will start
+            int* base = top;
+            if (base + cur->children.size() > stack + STACK) throw std::string("Stack overflow");
+            for (auto chd : cur->children) {
+                int x = Expression(chd);
+                *top++ = x;
+            }
+            top = base;
             ret.type = VALUE;
-            ret.value = Function(func_table[ret.name], params);
-            return ret;
-        } else if (ret.type == VARIABLE) {
-            return ret;
-        } else if (ret.type == ARRAY) {
-            for (auto chd : cur->children) 
-                ret.dims.push_back(Expression(chd));
-            return ret;
-        } else {
-            assert(0);
-            return ret;
+            ret.value = Function(obj.slot < 0 ? nullptr : Resolver::functions[obj.slot], base);
+        } else if (obj.type == VARIABLE) {
+            ret.ref = cell(obj);
+        } else if (obj.type == ARRAY) {
+            int off = 0;
+            for (size_t i = 0; i < cur->children.size(); i++)
+                off += obj.strides[i] * Expression(cur->children[i]);
+            ret.type = VARIABLE;
+            ret.ref = cell(obj) + off;
+        }
+        return ret;
+    }
+
+    // a call the optimizer expanded. it runs in the caller's frame, where
+    // the body's parameters and locals have a part of their own. nothing
+    // else uses that part, so the arguments go straight to the parameters
+    int Inline(Tree* cur) {
+        size_t n = cur->vars.size();
+        for (size_t i = 0; i < n; i++) {
+            int x = Expression(cur->children[i]);
+            *cell(cur->vars[i]) = x;
         }
+        int ret = Statements(cur->children[n]);
+        return_tag = false;
+        return ret;
     }
 
-    Object Unit1(Tree* cur) {
+    Value Unit1(Tree* cur) {
         // std::cerr << "in 1\n";
-        Object ret = Unit0(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
-            for (auto it = cur->ops.rbegin(); it != cur->ops.rend(); ++it) {
-                if (*it == "-") ret.value = -ret.value;
-                else if (*it == "!") ret.value = !ret.value;
+            ret = value(getVal(ret));
+            for (size_t i = cur->ops.size(); i-- > 0; ) {
+                if (cur->ops[i] == MINUS) ret.value = -ret.value;
+                else if (cur->ops[i] == NOT) ret.value = !ret.value;
             }
         }
         return ret;
     }
 
-    Object Unit2(Tree* cur) {
+    Value Unit2(Tree* cur) {
         // std::cerr << "in 2\n";
-        Object ret = Unit1(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                if (cur->ops[i] == "*") {
-                    ret.value = ret.value * getVal(Unit1(cur->children[i + 1]));
-                } else if (cur->ops[i] == "/") {
-                    ret.value = ret.value / getVal(Unit1(cur->children[i + 1]));
-                } else if (cur->ops[i] == "%") {
-                    ret.value = ret.value % getVal(Unit1(cur->children[i + 1]));
+                if (cur->ops[i] == TIMES) {
+                    ret.value = ret.value * getVal(Unit(cur->children[i + 1]));
+                } else if (cur->ops[i] == DIVIDE) {
+                    ret.value = ret.value / getVal(Unit(cur->children[i + 1]));
+                } else if (cur->ops[i] == MODULO) {
+                    ret.value = ret.value % getVal(Unit(cur->children[i + 1]));
                 }
             }
         }
         return ret;
     }
 
-    Object Unit3(Tree* cur) {
+    Value Unit3(Tree* cur) {
         // std::cerr << "in 3\n";
-        Object ret = Unit2(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                if (cur->ops[i] == "+") {
-                    ret.value = ret.value + getVal(Unit2(cur->children[i + 1]));
-                } else if (cur->ops[i] == "-") {
-                    ret.value = ret.value - getVal(Unit2(cur->children[i + 1]));
+                if (cur->ops[i] == PLUS) {
+                    ret.value = ret.value + getVal(Unit(cur->children[i + 1]));
+                } else if (cur->ops[i] == MINUS) {
+                    ret.value = ret.value - getVal(Unit(cur->children[i + 1]));
                 }
             }
         }
         return ret;
     }
 
-    Object Unit4(Tree* cur) {
+    Value Unit4(Tree* cur) {
         // std::cerr << "in 4\n";
-        Object ret = Unit3(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                if (cur->ops[i] == "<") {
-                    ret.value = (ret.value < getVal(Unit3(cur->children[i + 1])));
-                } else if (cur->ops[i] == "<=") {
-                    ret.value = (ret.value <= getVal(Unit3(cur->children[i + 1])));
-                } else if (cur->ops[i] == ">") {
-                    ret.value = (ret.value > getVal(Unit3(cur->children[i + 1])));
-                } else if (cur->ops[i] == ">=") {
-                    ret.value = (ret.value >= getVal(Unit3(cur->children[i + 1])));
+                if (cur->ops[i] == LESS) {
+                    ret.value = (ret.value < getVal(Unit(cur->children[i + 1])));
+                } else if (cur->ops[i] == LESS_EQUAL) {
+                    ret.value = (ret.value <= getVal(Unit(cur->children[i + 1])));
+                } else if (cur->ops[i] == GREATER) {
+                    ret.value = (ret.value > getVal(Unit(cur->children[i + 1])));
+                } else if (cur->ops[i] == GREATER_EQUAL) {
+                    ret.value = (ret.value >= getVal(Unit(cur->children[i + 1])));
                 }
             }
         }
         return ret;
     }
 
-    Object Unit5(Tree* cur) {
+    Value Unit5(Tree* cur) {
         // std::cerr << "in 5\n";
-        Object ret = Unit4(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                if (cur->ops[i] == "==") {
-                    ret.value = (ret.value == getVal(Unit4(cur->children[i + 1])));
-                } else if (cur->ops[i] == "!=") {
-                    ret.value = (ret.value != getVal(Unit4(cur->children[i + 1])));
+                if (cur->ops[i] == EQUAL) {
+                    ret.value = (ret.value == getVal(Unit(cur->children[i + 1])));
+                } else if (cur->ops[i] == NOT_EQUAL) {
+                    ret.value = (ret.value != getVal(Unit(cur->children[i + 1])));
                 } 
             }
         }
         return ret;
     }
 
-    Object Unit6(Tree* cur) {
+    Value Unit6(Tree* cur) {
         // std::cerr << "in 6\n";
-        Object ret = Unit5(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                ret.value = (ret.value ^ getVal(Unit5(cur->children[i + 1])));
+                ret.value = (ret.value ^ getVal(Unit(cur->children[i + 1])));
             }
         }
         return ret;
     }
 
-    Object Unit7(Tree* cur) {
+    Value Unit7(Tree* cur) {
         // std::cerr << "in 7\n";
-        Object ret = Unit6(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                ret.value = (ret.value && getVal(Unit6(cur->children[i + 1])));
+                ret.value = (ret.value && getVal(Unit(cur->children[i + 1])));
             }
         }
         return ret;
     }
 
-    Object Unit8(Tree* cur) {
+    Value Unit8(Tree* cur) {
         // std::cerr << "in 8\n";
-        Object ret = Unit7(cur->children[0]);
+        Value ret = Unit(cur->children[0]);
         if (!cur->ops.empty()) {
-            ret = Object(VALUE, getVal(ret));
+            ret = value(getVal(ret));
             for (size_t i = 0; i < cur->ops.size(); i++) {
-                ret.value = (ret.value || getVal(Unit7(cur->children[i + 1])));
+                ret.value = (ret.value || getVal(Unit(cur->children[i + 1])));
             }
         }
         return ret;
     }
 
-    Object Unit9(Tree* cur) {
+    // children are evaluated left to right before any store, as in C++;
+    // every target gets the value of the last one
+    Value Assign(Tree* cur, size_t i) {
+        Value ret = Unit(cur->children[i]);
+        if (i + 1 < cur->children.size()) {
+            int val = getVal(Assign(cur, i + 1));
+            getVar(ret) = val;
+        }
+        return ret;
+    }
+
+    Value Unit9(Tree* cur) {
         // std::cerr << "in 9\n";
-        std::vector<Object> rets;
-        for (size_t i = 0; i < cur->children.size(); i++) {
-            rets.push_back(Unit8(cur->children[i]));
+        return Assign(cur, 0);
+    }
+
+    void Main() {
+        globals.assign(Resolver::global_size, 0);
+        stack = (int*)malloc(STACK * sizeof(int));
+        top = locals = stack;
+        if (Jit::enabled) Jit::Init();
+        Memo::init();
+        int entry = Resolver::function("main");
+        if (entry < 0) throw std::string("Undefined function main");
+        Runner::Function(Resolver::functions[entry], nullptr);
+    }
+}
+
+// writes the whole program as GNU x86-64 assembly, using the same stack
+// discipline and calling convention as the JIT. the runtime at the end
+// reads and throws away the leading count of the input, so a binary can be
+// fed the same input file as the interpreter.
+namespace Assembly {
+    using namespace Bytecode;
+
+    std::unordered_map<int, std::string> global_name;
+
+    inline void helper(std::ostream& out, const char* fn) {
+        out << "\tmovq %rsp, %rbx\n\tandq $-16, %rsp\n\tcall " << fn << "\n\tmovq %rbx, %rsp\n";
+    }
+
+    void Function(std::ostream& out, int f) {
+        const Proto& proto = protos[f];
+        int locals = (4 * proto.frame + 7) & ~7;
+        auto local = [&](int off) { return std::to_string(-8 - locals + 4 * off) + "(%rbp)"; };
+        const int* begin = code.data() + proto.entry;
+        const int* end = code.data() + (f + 1 < int(protos.size()) ? protos[f + 1].entry : code.size());
+        std::set<int> targets;
+        for (const int* pc = begin; pc < end; ) {
+            int op = *pc++;
+            if (op == OP_JMP || op == OP_JZ || op == OP_JNZ) targets.insert(*pc);
+            if (op == OP_ZERO || op == OP_CALL || op == OP_TAILCALL) pc += 2;
+            else if (op <= OP_INDEX || op == OP_JMP || op == OP_JZ || op == OP_JNZ) pc++;
         }
-        if (!cur->ops.empty()) {
-            for (size_t i = 0; i + 1 < cur->children.size(); i++) {
-                getVar(rets[i]) = getVal(rets.back());
+        out << "fn." << proto.name << ":\n";
+        out << "\tpushq %rbp\n\tmovq %rsp, %rbp\n\tpushq %rbx\n\tsubq $" << locals << ", %rsp\n";
+        for (int i = 0; i < proto.params; i++) {
+            out << "\tmovl " << 8 * (proto.params - 1 - i) << "(%rdi), %eax\n";
+            out << "\tmovl %eax, " << local(i) << "\n";
+        }
+        for (const int* pc = begin; pc < end; ) {
+            if (targets.count(pc - code.data())) out << ".L" << pc - code.data() << ":\n";
+            int op = *pc++;
+            switch (op) {
+                case OP_CONST: out << "\tpushq $" << *pc++ << "\n"; break;
+                case OP_LOAD: out << "\tmovslq " << local(*pc++) << ", %rax\n\tpushq %rax\n"; break;
+                case OP_GLOAD: out << "\tmovslq " << global_name[*pc++] << "(%rip), %rax\n\tpushq %rax\n"; break;
+                case OP_STORE: out << "\tmovl (%rsp), %eax\n\tmovl %eax, " << local(*pc++) << "\n"; break;
+                case OP_GSTORE: out << "\tmovl (%rsp), %eax\n\tmovl %eax, " << global_name[*pc++] << "(%rip)\n"; break;
+                case OP_ADDR: out << "\tleaq " << local(*pc++) << ", %rax\n\tpushq %rax\n"; break;
+                case OP_GADDR: out << "\tleaq " << global_name[*pc++] << "(%rip), %rax\n\tpushq %rax\n"; break;
+                case OP_INDEX:
+                    out << "\tpopq %rcx\n\tmovslq %ecx, %rcx\n\timulq $" << 4 * *pc++ << ", %rcx, %rcx\n\taddq %rcx, (%rsp)\n";
+                    break;
+                case OP_LOADI: out << "\tpopq %rax\n\tmovslq (%rax), %rax\n\tpushq %rax\n"; break;
+                case OP_STOREI: out << "\tpopq %rcx\n\tpopq %rax\n\tmovl %ecx, (%rax)\n\tpushq %rcx\n"; break;
+                case OP_ZERO:
+                    out << "\tleaq " << local(pc[0]) << ", %rdi\n\tmovl $" << pc[1] << ", %ecx\n\txorl %eax, %eax\n\trep stosl\n";
+                    pc += 2;
+                    break;
+                case OP_POP: out << "\tpopq %rcx\n"; break;
+                case OP_ADD: out << "\tpopq %rcx\n\tpopq %rax\n\taddl %ecx, %eax\n\tpushq %rax\n"; break;
+                case OP_SUB: out << "\tpopq %rcx\n\tpopq %rax\n\tsubl %ecx, %eax\n\tpushq %rax\n"; break;
+                case OP_MUL: out << "\tpopq %rcx\n\tpopq %rax\n\timull %ecx, %eax\n\tpushq %rax\n"; break;
+                case OP_DIV: out << "\tpopq %rcx\n\tpopq %rax\n\tcltd\n\tidivl %ecx\n\tpushq %rax\n"; break;
+                case OP_MOD: out << "\tpopq %rcx\n\tpopq %rax\n\tcltd\n\tidivl %ecx\n\tpushq %rdx\n"; break;
+                case OP_XOR: out << "\tpopq %rcx\n\tpopq %rax\n\txorl %ecx, %eax\n\tpushq %rax\n"; break;
+                case OP_SHL: out << "\tpopq %rcx\n\tpopq %rax\n\tshll %cl, %eax\n\tpushq %rax\n"; break;
+                case OP_SHR: out << "\tpopq %rcx\n\tpopq %rax\n\tsarl %cl, %eax\n\tpushq %rax\n"; break;
+                case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE: {
+                    const char* cc = op == OP_LT ? "l" : op == OP_LE ? "le" : op == OP_GT ? "g" :
+                                     op == OP_GE ? "ge" : op == OP_EQ ? "e" : "ne";
+                    out << "\tpopq %rcx\n\tpopq %rax\n\tcmpl %ecx, %eax\n\tset" << cc << " %al\n\tmovzbl %al, %eax\n\tpushq %rax\n";
+                    break;
+                }
+                case OP_NEG: out << "\tnegl (%rsp)\n"; break;
+                case OP_NOT: out << "\tpopq %rax\n\ttestl %eax, %eax\n\tsete %al\n\tmovzbl %al, %eax\n\tpushq %rax\n"; break;
+                case OP_JMP: out << "\tjmp .L" << *pc++ << "\n"; break;
+                case OP_JZ: out << "\tpopq %rax\n\ttestl %eax, %eax\n\tjz .L" << *pc++ << "\n"; break;
+                case OP_JNZ: out << "\tpopq %rax\n\ttestl %eax, %eax\n\tjnz .L" << *pc++ << "\n"; break;
+                case OP_CALL:
+                case OP_TAILCALL:
+                    out << "\tmovq %rsp, %rdi\n\tcall fn." << protos[pc[0]].name << "\n";
+                    out << "\taddq $" << 8 * pc[1] << ", %rsp\n\tpushq %rax\n";
+                    if (op == OP_TAILCALL) out << "\tpopq %rax\n\tmovq -8(%rbp), %rbx\n\tleave\n\tret\n";
+                    pc += 2;
+                    break;
+                case OP_RET: out << "\tpopq %rax\n\tmovq -8(%rbp), %rbx\n\tleave\n\tret\n"; break;
+                case OP_READ: helper(out, "rt.read"), out << "\tpushq %rax\n"; break;
+                case OP_PRINT: out << "\tpopq %rdi\n", helper(out, "rt.print"); break;
+                case OP_ENDL: helper(out, "rt.endl"); break;
+                case OP_PUTCHAR: out << "\tpopq %rdi\n", helper(out, "rt.putchar"), out << "\tpushq %rax\n"; break;
+                default: assert(0);
             }
         }
-        // std::cerr << "done\n";
-        // std::cerr << rets[0].name << "\n";
-        return rets[0];
     }
 
-    void Main() {
+    void Program(std::ostream& out) {
+        Bytecode::Program(Root);
+        int entry = Resolver::function("main");
+        if (entry < 0) throw std::string("Undefined function main");
+        out << "\t.bss\n\t.align 4\n";
         for (auto chd : Root->children) {
-            if (chd->type == VARDEF) {
-                for (auto obj : chd->vars) {
-                    var_table[obj.name].emplace_back(obj.type);
-                    if (obj.type == ARRAY) {
-                        auto& u = var_table[obj.name].back();
-                        u.setArray(obj.dims);
-                    }
-                }
+            if (chd->type != VARDEF) continue;
+            for (auto& obj : chd->vars) {
+                global_name[obj.slot] = std::string("g.") + Symbol::name(obj.name);
+                out << global_name[obj.slot] << ":\n\t.zero " << 4 * Resolver::size(obj) << "\n";
             }
         }
-        Runner::Function(func_table["main"], std::vector<int>());
+        out << "\t.section .rodata\nfmt.d:\n\t.string \"%d\"\n";
+        out << "\t.text\n";
+        for (size_t f = 0; f < protos.size(); f++) Function(out, f);
+        out << "\t.globl main\n\t.type main, @function\nmain:\n";
+        out << "\tpushq %rbx\n\tcall rt.read\n\tmovq %rsp, %rdi\n\tcall fn.main\n";
+        out << "\txorl %eax, %eax\n\tpopq %rbx\n\tret\n";
+        out << "rt.read:\n\tsubq $24, %rsp\n\tmovl $0, 12(%rsp)\n\tleaq 12(%rsp), %rsi\n\tleaq fmt.d(%rip), %rdi\n";
+        out << "\txorl %eax, %eax\n\tcall scanf@PLT\n\tmovl 12(%rsp), %eax\n\taddq $24, %rsp\n\tret\n";
+        out << "rt.print:\n\tsubq $8, %rsp\n\tmovl %edi, %esi\n\tleaq fmt.d(%rip), %rdi\n";
+        out << "\txorl %eax, %eax\n\tcall printf@PLT\n\taddq $8, %rsp\n\tret\n";
+        out << "rt.endl:\n\tsubq $8, %rsp\n\tmovl $10, %edi\n\tcall putchar@PLT\n\taddq $8, %rsp\n\tret\n";
+        out << "rt.putchar:\n\tsubq $8, %rsp\n\tmovsbl %dil, %edi\n\tcall putchar@PLT\n";
+        out << "\txorl %eax, %eax\n\taddq $8, %rsp\n\tret\n";
+        out << "\t.section .note.GNU-stack,\"\",@progbits\n";
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
 #ifdef ARK
     freopen("test.in", "r", stdin);
     freopen("error.out", "w", stderr);
 #endif
-    int n;
-    std::cin >> n;
-    for (int i = 1, j; i <= n; i++) {
-        std::cin >> j;
-        Reader::numbers.push_back(j);
+    bool vm = false;
+    const char* assembly = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--engine=vm")) vm = true;
+        else if (!strcmp(argv[i], "--engine=tree")) vm = false;
+        else if (!strcmp(argv[i], "--jit")) Jit::enabled = true;
+        else if (!strcmp(argv[i], "-S") && i + 1 < argc) assembly = argv[++i];
+        else if (!strncmp(argv[i], "--jit-threshold=", 16)) Jit::threshold = atoi(argv[i] + 16);
+        else if (!strncmp(argv[i], "--stack-limit=", 14)) VM::limit = size_t(atoi(argv[i] + 14)) << 20;
+        else if (!strcmp(argv[i], "--lazy")) Parser::lazy = true;
+        else if (!strcmp(argv[i], "--avx2")) Scan::avx2Wanted = true;
+        else if (!strncmp(argv[i], "--parse-threads=", 16)) Parser::threads = Parser::count(atoi(argv[i] + 16));
+        else if (!strcmp(argv[i], "--input=eager")) Reader::mode = Reader::EAGER;
+        else if (!strcmp(argv[i], "--input=lazy")) Reader::mode = Reader::LAZY;
+        else if (!strcmp(argv[i], "--input=pipe")) Reader::mode = Reader::PIPE;
+        else if (!strcmp(argv[i], "--interactive")) Output::interactive = true;
+        else if (!strcmp(argv[i], "--no-fold")) Optimizer::fold = false;
+        else if (!strcmp(argv[i], "--no-dce")) Optimizer::dce = false;
+        else if (!strcmp(argv[i], "--no-tail")) Optimizer::tail = false;
+        else if (!strcmp(argv[i], "--stats")) Optimizer::stats = true;
+        else if (!strncmp(argv[i], "--inline=", 9)) Optimizer::limit = atoi(argv[i] + 9);
+        else if (!strncmp(argv[i], "--memo=", 7)) Memo::cap = size_t(atoi(argv[i] + 7)) << 20;
+        else if (!strcmp(argv[i], "--memo-evict=lru")) Memo::lru = true;
+        else if (!strcmp(argv[i], "--memo-evict=fifo")) Memo::lru = false;
+        else {
+            std::cerr << "usage: " << argv[0] << " [--engine=tree|vm] [--jit] [--jit-threshold=N] [--stack-limit=MB] [--lazy] [--avx2] [--parse-threads=N] [--input=eager|lazy|pipe] [--interactive] [--no-fold] [--no-dce] [--no-tail] [--inline=N] [--memo=MB] [--memo-evict=lru|fifo] [--stats] [-S out.s]" << std::endl;
+            return 1;
+        }
     }
+    Stream::load();
+    Scan::init();
+    Reader::load();
     try {
-        Root = Parser::Program();
+        Lexer::Run();
+        // every other backend compiles all functions before running any
+        if (vm || Jit::enabled || assembly != nullptr) Parser::lazy = false;
+        // only the tree walker runs INLINE nodes, and a lazy body is
+        // optimized when it is first called, too late to be copied
+        if (vm || Jit::enabled || assembly != nullptr || Parser::lazy) Optimizer::limit = 0;
+        // compiled code calls compiled code without asking the cache
+        if (vm || Jit::enabled || assembly != nullptr) Memo::cap = 0;
+        if (Parser::lazy) Ast::reserve(Lexer::tokens.size());
+        Ast::init();
+        Root = Ast::at(Parser::Program());
+        Resolver::Program(Root);
+        Optimizer::Program(Root);
     } catch(std::string s) {
+        // a program the front end refused is not run, nor compiled
         std::cerr << s << std::endl;
+        Output::flush();
+        Reader::finish();
+        return 1;
     }
     // std::cerr << "parser done.\n";
-    Runner::Main();
+    if (assembly != nullptr) {
+        try {
+            // out.s is only written once the whole program has been lowered
+            std::ostringstream text;
+            Assembly::Program(text);
+            std::ofstream out(assembly);
+            out << text.str();
+            if (!out) throw std::string("Cannot write ") + assembly;
+        } catch(std::string s) {
+            std::cerr << s << std::endl;
+            Reader::finish();
+            return 1;
+        }
+    } else if (vm) {
+        try {
+            VM::Main();
+        } catch(std::string s) {
+            std::cerr << s << std::endl;
+        }
+    } else {
+        try {
+            Runner::Main();
+        } catch(std::string s) {
+            std::cerr << s << std::endl;
+        }
+    }
+    Output::flush();
+    Reader::finish();
+    if (Optimizer::stats) {
+        std::cerr << "dce: removed " << Optimizer::removed << " nodes and "
+                  << Optimizer::unused << " unused locals" << std::endl;
+        std::cerr << "inline: expanded " << Optimizer::inlined << " calls" << std::endl;
+        std::cerr << "memo: " << Memo::hits << " hits in " << Memo::lookups << " lookups";
+        if (Memo::lookups > 0) std::cerr << " (" << 100.0 * Memo::hits / Memo::lookups << "%)";
+        std::cerr << std::endl;
+    }
+    Root = nullptr;
+    Ast::release();
     // std::cerr << "runner done.\n";
     // for (int i = 1; i <= 20; ++i)
         // std::cout << Lexer::getLexeme().empty() << std::endl;